@@ -0,0 +1,244 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+// Drives the real PCA9685_i2c, servo and IBT_2 classes against a
+// virtualPCA9685 and prints what ends up on the pins, together with the
+// bus cost of every command. Uses the pin numbers of mainCar.cpp.
+
+#include "hwlib.hpp"
+#include "virtualPCA9685.hpp"
+#include "PCA9685.hpp"
+#include "motorController.hpp"
+#include "auxOutputs.hpp"
+#include "driveSetup.hpp"
+
+#include <cstdio>
+#include <random>
+
+namespace {
+
+hwlib::host::board carBoard;
+virtualPCA9685 chip(carBoard, 0x40, 27000000);
+
+struct cost {
+    uint_fast32_t transactions;
+    uint_fast32_t bytes;
+    uint_fast64_t ns;
+};
+
+cost snapshot() {
+    auto & t = chip.traffic();
+    return cost{ t.writeTransactions + t.readTransactions, t.bytesWritten + t.bytesRead, carBoard.now_ns() };
+}
+
+void printCost(const char * what, const cost & before) {
+    cost after = snapshot();
+    std::printf("%-28s %2lu transactions %3lu bytes %7.1f us |", what,
+                (unsigned long) (after.transactions - before.transactions),
+                (unsigned long) (after.bytes - before.bytes), (after.ns - before.ns) / 1000.0);
+    for (uint8_t n = 0; n < 7; n++) {
+        std::printf(" ch%d %4d@%-4d", n, chip.channel(n).ticks, chip.channel(n).on);
+    }
+    std::printf("\n");
+}
+
+} // namespace
+
+int main() {
+    hwlib::host::board_scope scope(carBoard);
+    carBoard.attach(chip);
+
+    auto scl = due::pin_oc(due::pins::scl);
+    auto sda = due::pin_oc(due::pins::sda);
+    auto i2c_bus = hwlib::i2c_bus_bit_banged_scl_sda(scl, sda);
+    auto PCA = PCA9685_i2c(i2c_bus);
+
+    cost before = snapshot();
+    PCA.begin();
+    PCA.setOscillatorFrequency(27000000);
+    PCA.setPWMFreq(50);
+    printCost("begin + setPWMFreq(50)", before);
+    std::printf("pwm frequency %.2f Hz, %lu prescale writes ignored\n\n", chip.frequencyHz(),
+                (unsigned long) chip.traffic().ignoredPrescaleWrites);
+
+    // the pins and the ranges of mainCar.cpp
+    using namespace driveSetup;
+    IBT_2 motor(PCA, PWMPIN, FORWARDDIRPIN, BACKWARDDIRPIN);
+    servo ser(PCA, SERVOPIN, rangeMin, rangeMax, USMIN, USMAX);
+
+    for (int x = -512; x <= 511; x += 256) {
+        char what[40];
+        int16_t us = ser.mapInverse(x);
+        before = snapshot();
+        ser.setPosition(us);
+        std::snprintf(what, sizeof(what), "servo %5d -> %4d us", x, us);
+        printCost(what, before);
+        std::printf("%-28s measured %.1f us\n", "", chip.pulseWidthUs(SERVOPIN));
+    }
+    std::printf("\n");
+
+    const struct { bool forward; uint16_t speed; } commands[] = {
+        { true, 0 }, { true, 2048 }, { true, 4092 }, { false, 4092 }, { false, 1024 }, { true, 0 }
+    };
+    for (auto & c : commands) {
+        char what[40];
+        size_t first = chip.changes().size();
+        before = snapshot();
+        motor.setDirection(c.forward);
+        motor.setSpeed(c.speed);
+        std::snprintf(what, sizeof(what), "motor %s %4d", c.forward ? "forward " : "backward", c.speed);
+        printCost(what, before);
+        // every separate output change is a state the H-bridge actually sees
+        for (size_t i = first; i < chip.changes().size(); i++) {
+            auto & ch = chip.changes()[i];
+            std::printf("%-28s   t+%6.1f us ch%d -> %4d ticks\n", "", (ch.ns - before.ns) / 1000.0, ch.channel, ch.value.ticks);
+        }
+    }
+
+    std::printf("\n");
+
+    // the same reversals with a batch around them, together with the aux pins of mainCar.cpp
+    auxOutputs aux(PCA, auxChannels, AUX_CHANNELS);
+    for (auto & c : commands) {
+        char what[40];
+        size_t first = chip.changes().size();
+        before = snapshot();
+        PCA.beginBatch();
+        motor.setDirection(c.forward);
+        motor.setSpeed(c.speed);
+        ser.setPosition(1500);
+        aux.set(0, c.forward ? 4095 : 0);
+        aux.set(1, c.speed);
+        aux.set(2, c.forward ? 0 : 4095);
+        PCA.endBatch();
+        std::snprintf(what, sizeof(what), "batch %s %4d + aux", c.forward ? "forward " : "backward", c.speed);
+        printCost(what, before);
+        if (chip.changes().size() > first) {
+            std::printf("%-28s   %lu changes, all at t+%.1f us\n", "", (unsigned long) (chip.changes().size() - first),
+                        (chip.changes().back().ns - before.ns) / 1000.0);
+        }
+    }
+
+    std::printf("\n");
+
+    // setVelocity on its own, including a stop with the brake
+    const struct { int16_t velocity; stopMode mode; } velocities[] = {
+        { 2048, stopMode::COAST }, { -2048, stopMode::COAST }, { 0, stopMode::COAST },
+        { 4092, stopMode::BRAKE }, { 0, stopMode::BRAKE }, { -1024, stopMode::BRAKE }
+    };
+    for (auto & v : velocities) {
+        char what[40];
+        size_t first = chip.changes().size();
+        motor.setStopMode(v.mode);
+        before = snapshot();
+        motor.setVelocity(v.velocity);
+        std::snprintf(what, sizeof(what), "velocity %5d %s", v.velocity, v.mode == stopMode::BRAKE ? "brake" : "coast");
+        printCost(what, before);
+        if (chip.changes().size() > first) {
+            std::printf("%-28s   %lu changes, all at t+%.1f us\n", "", (unsigned long) (chip.changes().size() - first),
+                        (chip.changes().back().ns - before.ns) / 1000.0);
+        }
+    }
+
+    std::printf("\n");
+
+    // the pulsed loads of mainCar.cpp all switched on at tick 0, and then staggered like mainCar does.
+    // the lights are a SWITCH that is always on, pulsedAuxPins leaves them out there too
+    const uint16_t pulsed = STAGGERED_PINS;
+    for (bool stagger : { false, true }) {
+        if (stagger) {
+            PCA.staggerPhases(pulsed);
+        }
+        PCA.beginBatch();
+        motor.setVelocity(3600);
+        ser.setPosition(2000);
+        aux.set(1, 4095);
+        aux.set(2, 4095);
+        PCA.endBatch();
+        std::printf("%-28s peak %d of 4 pulsed pins high at once |", stagger ? "staggered phases" : "all phases 0",
+                    chip.peakSimultaneousOn(pulsed));
+        for (uint8_t n = 0; n < 7; n++) {
+            if (pulsed & (1u << n)) {
+                std::printf(" ch%d %4d@%-4d", n, chip.channel(n).ticks, chip.channel(n).on);
+            }
+        }
+        std::printf("\n");
+    }
+
+    std::printf("\n");
+
+    // steady driving: 200 frames with the stick held still, the steering noisy by a few us and the
+    // speed controller moving the motor by a few ticks, without and with the deadbands of mainCar.cpp
+    for (bool deadbands : { false, true }) {
+        PCA.setDeadband(SERVOPIN, deadbands ? SERVO_DEADBAND : 0);
+        PCA.setDeadband(PWMPIN, deadbands ? MOTOR_DEADBAND : 0);
+        std::mt19937 noise(1);
+        std::uniform_int_distribution<int> servoNoise(-8, 8), motorNoise(-6, 6);
+        pca9685Statistics start = PCA.statistics();
+        before = snapshot();
+        for (int frame = 0; frame < 200; frame++) {
+            PCA.beginBatch();
+            motor.setVelocity(2000 + motorNoise(noise));
+            ser.setPosition(1700 + servoNoise(noise));
+            PCA.endBatch();
+        }
+        const pca9685Statistics & end = PCA.statistics();
+        cost after = snapshot();
+        std::printf("%-28s %4lu pin writes %4lu suppressed %3lu transactions %5lu bytes %7.1f ms on the bus\n",
+                    deadbands ? "steady, deadbands" : "steady, exact values only",
+                    (unsigned long) (end.pinWrites - start.pinWrites), (unsigned long) (end.suppressed - start.suppressed),
+                    (unsigned long) (end.transactions - start.transactions), (unsigned long) (end.bytes - start.bytes),
+                    (after.ns - before.ns) / 1e6);
+    }
+
+    std::printf("\n");
+
+    // standstill sleep of mainCar.cpp: the chip sleeps, the next command wakes it. the latency is
+    // from the command until the new values are on the bus, and until the pins actually change
+    for (bool batch : { false, true }) {
+        before = snapshot();
+        PCA.sleep();
+        printCost("sleep", before);
+        hwlib::wait_ms(100);
+        size_t first = chip.changes().size();
+        before = snapshot();
+        if (batch) {
+            PCA.beginBatch();
+        }
+        ser.setPosition(batch ? 1200 : 1800);
+        motor.setVelocity(batch ? -1500 : 1500);
+        if (batch) {
+            PCA.endBatch();
+        }
+        printCost(batch ? "wake by batch" : "wake by pin writes", before);
+        const pca9685Statistics & stats = PCA.statistics();
+        std::printf("%-28s %lu wakes, outputs running %lu us after the command", "", (unsigned long) stats.wakes,
+                    (unsigned long) stats.wakeLatencyUs);
+        if (chip.changes().size() > first) {
+            std::printf(", pins changing from t+%.1f us", (chip.changes()[first].ns - before.ns) / 1000.0);
+        }
+        std::printf(", chip %s\n", chip.running() ? "running" : "stopped");
+    }
+
+    // a braked car that sleeps lets go of the brake, and the shadow registers still hold the brake,
+    // so setVelocity(0) writes nothing. carDrive wakes the chip once the car rolls, the restart brings the brake back
+    motor.setStopMode(stopMode::BRAKE);
+    motor.setVelocity(0);
+    PCA.sleep();
+    before = snapshot();
+    motor.setVelocity(0);
+    printCost("brake while asleep", before);
+    std::printf("%-28s chip %s\n", "", chip.running() ? "running" : "stopped");
+    before = snapshot();
+    PCA.wakeup();
+    printCost("wake for a rolling car", before);
+    std::printf("%-28s chip %s, ch%d %d ticks, ch%d %d, ch%d %d\n", "", chip.running() ? "running" : "stopped",
+                PWMPIN, chip.channel(PWMPIN).ticks, FORWARDDIRPIN, chip.channel(FORWARDDIRPIN).ticks,
+                BACKWARDDIRPIN, chip.channel(BACKWARDDIRPIN).ticks);
+}
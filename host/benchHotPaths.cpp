@@ -0,0 +1,265 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+// Google Benchmark suite for the code that runs every loop on the remote or
+// the car. Bus traffic of the PCA9685 functions is reported as counters next
+// to the cpu time. `make bench` writes the results to build/bench.json so
+// two builds can be compared.
+
+#include "hwlib.hpp"
+#include "PCA9685.hpp"
+#include "motorController.hpp"
+#include "staticDrive.hpp"
+#include "responseCurve.hpp"
+#include "MovingAverage.hpp"
+#include "Receiver433mhz.hpp"
+#include "Transmit433mhzController.hpp"
+
+#include <benchmark/benchmark.h>
+
+namespace {
+
+/**
+ * \class registerFile. minimal stand-in for a PCA9685: 256 auto incrementing registers
+ */
+class registerFile : public hwlib::host::i2c_device {
+private:
+    uint8_t registers[256] = {0};
+    uint8_t pointer = 0;
+    bool first = false;
+
+public:
+    registerFile() {
+        // the prescale for 50Hz with a 27MHz oscillator
+        registers[0xFE] = 131;
+    }
+
+    bool acknowledges(uint_fast8_t address) const override {
+        return address == 0x40;
+    }
+
+    void write_start() override {
+        first = true;
+    }
+
+    void write_byte(uint8_t b) override {
+        if (first) {
+            pointer = b;
+            first = false;
+        } else {
+            registers[pointer++] = b;
+        }
+    }
+
+    uint8_t read_byte() override {
+        return registers[pointer++];
+    }
+};
+
+/**
+ * \brief report the bus traffic of the benchmark loop as averages per iteration
+ */
+void busCounters(benchmark::State & state, const hwlib::host::i2c_statistics & before) {
+    auto & after = hwlib::host::active_board().i2c;
+    state.counters["i2c_transactions"] = benchmark::Counter(
+        (after.write_transactions + after.read_transactions) - (before.write_transactions + before.read_transactions),
+        benchmark::Counter::kAvgIterations);
+    state.counters["i2c_bytes"] = benchmark::Counter(
+        (after.bytes_written + after.bytes_read) - (before.bytes_written + before.bytes_read),
+        benchmark::Counter::kAvgIterations);
+    state.counters["i2c_busy_us"] = benchmark::Counter(
+        (after.busy_ns - before.busy_ns) / 1000.0, benchmark::Counter::kAvgIterations);
+}
+
+void BM_decodeMessage(benchmark::State & state) {
+    hwlib::host::board b;
+    hwlib::host::board_scope scope(b);
+    auto pin = due::pin_in(due::pins::d2);
+    Receiver433mhz receiver(pin);
+    uint8_t frame[5] = { 0x01, 0xC7, 0x3A, 0x51, 0x9E };
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(frame);
+        benchmark::DoNotOptimize(receiver.decodeMessage(frame));
+    }
+}
+BENCHMARK(BM_decodeMessage);
+
+void BM_encodeMessage(benchmark::State & state) {
+    hwlib::host::board b;
+    hwlib::host::board_scope scope(b);
+    auto pin = due::pin_out(due::pins::d9);
+    constructMessage message(pin);
+    uint16_t value = 0;
+    for (auto _ : state) {
+        message.setY(value & 1023);
+        message.setX(value & 511);
+        message.encodeMessage();
+        benchmark::DoNotOptimize(message.getMessage()[0]);
+        value++;
+    }
+}
+BENCHMARK(BM_encodeMessage);
+
+void BM_makeMessage(benchmark::State & state) {
+    hwlib::host::board b;
+    hwlib::host::board_scope scope(b);
+    auto pin = due::pin_out(due::pins::d9);
+    constructMessage message(pin);
+    uint16_t value = 0;
+    for (auto _ : state) {
+        message.setMotorDir(value & 1);
+        message.setY(value & 4095);
+        message.makeMessage();
+        value += 7;
+    }
+    state.counters["virtual_us"] = benchmark::Counter(b.now_ns() / 1000.0, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_makeMessage);
+
+void BM_movingAverage(benchmark::State & state) {
+    MovingAverage<uint16_t> average(state.range(0));
+    uint16_t value = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(average.CalculateMovingAverage(value));
+        value = (value + 37) & 4095;
+    }
+}
+BENCHMARK(BM_movingAverage)->Arg(20)->Arg(50);
+
+void BM_adapter(benchmark::State & state) {
+    uint16_t value = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(constructMessage::adapter(value, 0, 4095, 0, 1023));
+        value = (value + 37) & 4095;
+    }
+}
+BENCHMARK(BM_adapter);
+
+void BM_servoMap(benchmark::State & state) {
+    hwlib::host::board b;
+    hwlib::host::board_scope scope(b);
+    auto scl = due::pin_oc(due::pins::scl);
+    auto sda = due::pin_oc(due::pins::sda);
+    hwlib::i2c_bus_bit_banged_scl_sda bus(scl, sda);
+    PCA9685_i2c pca(bus);
+    servo ser(pca, 0, -512, 511);
+    int16_t value = -512;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ser.map(value));
+        value = value < 511 ? value + 1 : -512;
+    }
+}
+BENCHMARK(BM_servoMap);
+
+void BM_servoMapInverse(benchmark::State & state) {
+    hwlib::host::board b;
+    hwlib::host::board_scope scope(b);
+    auto scl = due::pin_oc(due::pins::scl);
+    auto sda = due::pin_oc(due::pins::sda);
+    hwlib::i2c_bus_bit_banged_scl_sda bus(scl, sda);
+    PCA9685_i2c pca(bus);
+    servo ser(pca, 0, -512, 511);
+    int16_t value = -512;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ser.mapInverse(value));
+        value = value < 511 ? value + 1 : -512;
+    }
+}
+BENCHMARK(BM_servoMapInverse);
+
+void BM_setPin(benchmark::State & state) {
+    hwlib::host::board b;
+    hwlib::host::board_scope scope(b);
+    registerFile chip;
+    b.attach(chip);
+    auto scl = due::pin_oc(due::pins::scl);
+    auto sda = due::pin_oc(due::pins::sda);
+    hwlib::i2c_bus_bit_banged_scl_sda bus(scl, sda);
+    PCA9685_i2c pca(bus);
+    auto before = b.i2c;
+    uint16_t value = 0;
+    for (auto _ : state) {
+        pca.setPin(1, value);
+        value = (value + 13) & 4095;
+    }
+    busCounters(state, before);
+}
+BENCHMARK(BM_setPin);
+
+void BM_writeMicroseconds(benchmark::State & state) {
+    hwlib::host::board b;
+    hwlib::host::board_scope scope(b);
+    registerFile chip;
+    b.attach(chip);
+    auto scl = due::pin_oc(due::pins::scl);
+    auto sda = due::pin_oc(due::pins::sda);
+    hwlib::i2c_bus_bit_banged_scl_sda bus(scl, sda);
+    PCA9685_i2c pca(bus);
+    pca.setOscillatorFrequency(27000000);
+    auto before = b.i2c;
+    uint16_t value = 500;
+    for (auto _ : state) {
+        pca.writeMicroseconds(0, value);
+        value = value < 2500 ? value + 1 : 500;
+    }
+    busCounters(state, before);
+}
+BENCHMARK(BM_writeMicroseconds);
+
+// the cpu side of a drive command: the batch stays open, so nothing goes out on the bus
+void BM_setVelocityVirtual(benchmark::State & state) {
+    hwlib::host::board b;
+    hwlib::host::board_scope scope(b);
+    auto scl = due::pin_oc(due::pins::scl);
+    auto sda = due::pin_oc(due::pins::sda);
+    hwlib::i2c_bus_bit_banged_scl_sda bus(scl, sda);
+    PCA9685_i2c pca(bus);
+    IBT_2 motor(pca, 1, 3, 2);
+    motorController * controller = &motor;
+    benchmark::DoNotOptimize(controller);
+    pca.beginBatch();
+    int16_t value = -4095;
+    for (auto _ : state) {
+        controller->setVelocity(value);
+        value = value < 4095 ? value + 13 : -4095;
+    }
+}
+BENCHMARK(BM_setVelocityVirtual);
+
+void BM_setVelocityStatic(benchmark::State & state) {
+    hwlib::host::board b;
+    hwlib::host::board_scope scope(b);
+    auto scl = due::pin_oc(due::pins::scl);
+    auto sda = due::pin_oc(due::pins::sda);
+    hwlib::i2c_bus_bit_banged_scl_sda bus(scl, sda);
+    PCA9685_i2c pca(bus);
+    staticIBT_2<1, 3, 2> motor(pca);
+    pca.beginBatch();
+    int16_t value = -4095;
+    for (auto _ : state) {
+        motor.setVelocity(value);
+        value = value < 4095 ? value + 13 : -4095;
+    }
+}
+BENCHMARK(BM_setVelocityStatic);
+
+// one stick sample through a response curve, the table lookup that replaces the curve maths
+void BM_responseCurve(benchmark::State & state) {
+    static constexpr responseCurve curve = expoCurve(30, 80);
+    uint16_t input = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(curve.apply(input));
+        input = (input + 37) & 0x0FFF;
+    }
+}
+BENCHMARK(BM_responseCurve);
+
+} // namespace
+
+BENCHMARK_MAIN();
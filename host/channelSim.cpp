@@ -0,0 +1,314 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+// RF link simulator: the real constructMessage on a simulated remote sends
+// random commands, an rfChannel impairs the pulses and the real
+// Receiver433mhz on a simulated car decodes them. Prints throughput, frame
+// error rate, false accepts and end-to-end latency.
+// With --cars every car gets its own remote and address and all remotes share
+// the channel, --tdma 1 gives every remote a slotScheduler slot. The remotes
+// are switched on at a random moment in the first 300 ms, but share the epoch.
+// --capture writes the edges seen by the first car to a file for host/replay,
+// with the number of frames that car accepted, which a replay has to match.
+// The capture keeps whole microseconds, so with --capture the channel puts
+// every edge on that grid.
+//
+// usage: channelsim [--frames n] [--jitter us] [--stretch us] [--flip p]
+//                   [--burst-rate per_s] [--burst us] [--noise-rate per_s]
+//                   [--keepalive n] [--gap ms] [--seed n] [--cars n] [--tdma 0|1]
+//                   [--capture file]
+
+#include "hwlib.hpp"
+#include "rfChannel.hpp"
+#include "Transmit433mhzController.hpp"
+#include "Receiver433mhz.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+
+/**
+ * \struct command. the content of one frame as it should arrive at the car
+ */
+struct command {
+    bool motorDir;
+    bool servoDir;
+    uint16_t Y;
+    uint16_t X;
+
+    bool operator==(const command & other) const {
+        return motorDir == other.motorDir && servoDir == other.servoDir && Y == other.Y && X == other.X;
+    }
+};
+
+struct settings {
+    unsigned long frames = 1000;
+    unsigned long keepalive = 0;    /**< keepalives sent before every frame */
+    double gapMs = 0;               /**< idle time of the remote loop after every frame */
+    unsigned long cars = 1;         /**< number of remote and car pairs sharing the channel */
+    bool tdma = false;              /**< give every remote its own time slot */
+    const char * capture = nullptr; /**< file to write the edges at the first car to */
+    channelImpairments channel;
+};
+
+void usage() {
+    std::fprintf(stderr,
+        "usage: channelsim [--frames n] [--jitter us] [--stretch us] [--flip p]\n"
+        "                  [--burst-rate per_s] [--burst us] [--noise-rate per_s]\n"
+        "                  [--keepalive n] [--gap ms] [--seed n] [--cars n] [--tdma 0|1]\n"
+        "                  [--capture file]\n");
+    std::exit(1);
+}
+
+settings parse(int argc, char * argv[]) {
+    settings s;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            usage();
+        }
+        const char * option = argv[i];
+        double value = std::strtod(argv[++i], nullptr);
+        if (!std::strcmp(option, "--capture")) {
+            s.capture = argv[i];
+        } else if (!std::strcmp(option, "--frames")) {
+            s.frames = value;
+        } else if (!std::strcmp(option, "--jitter")) {
+            s.channel.jitterUs = value;
+        } else if (!std::strcmp(option, "--stretch")) {
+            s.channel.stretchUs = value;
+        } else if (!std::strcmp(option, "--flip")) {
+            s.channel.flipRate = value;
+        } else if (!std::strcmp(option, "--burst-rate")) {
+            s.channel.burstRate = value;
+        } else if (!std::strcmp(option, "--burst")) {
+            s.channel.burstUs = value;
+        } else if (!std::strcmp(option, "--noise-rate")) {
+            s.channel.noiseRate = value;
+        } else if (!std::strcmp(option, "--keepalive")) {
+            s.keepalive = value;
+        } else if (!std::strcmp(option, "--gap")) {
+            s.gapMs = value;
+        } else if (!std::strcmp(option, "--seed")) {
+            s.channel.seed = value;
+        } else if (!std::strcmp(option, "--cars")) {
+            s.cars = value;
+        } else if (!std::strcmp(option, "--tdma")) {
+            s.tdma = value != 0;
+        } else {
+            usage();
+        }
+    }
+    if (s.cars < 1 || s.cars > 255) {
+        usage();
+    }
+    return s;
+}
+
+/**
+ * \struct sentFrame. a frame on its way to a car
+ */
+struct sentFrame {
+    command expected;
+    uint_fast64_t start;
+};
+
+/**
+ * \struct link. one remote with the car it controls, each on its own board
+ */
+struct link {
+    hwlib::host::board remoteBoard;
+    hwlib::host::board carBoard;
+    pulseRecorder recorder;
+    std::unique_ptr<due::pin_out> transmitterPin;
+    std::unique_ptr<constructMessage> message;
+    std::unique_ptr<Transmit433mhzController> keepAlive;
+    std::unique_ptr<slotScheduler> slots;
+    std::unique_ptr<due::pin_in> receiverPin;
+    std::unique_ptr<Receiver433mhz> receiver;
+
+    unsigned long sent = 0;
+    unsigned long good = 0;
+    unsigned long accepted = 0;
+    std::deque<sentFrame> inFlight;
+};
+
+} // namespace
+
+int main(int argc, char * argv[]) {
+    settings s = parse(argc, argv);
+
+    rfChannel channel(s.channel);
+    std::mt19937_64 random(s.channel.seed + 1);
+    std::uniform_int_distribution<uint16_t> axis(0, 4095);
+
+    std::vector<std::unique_ptr<link>> links;
+    for (unsigned long i = 0; i < s.cars; i++) {
+        links.emplace_back(new link);
+        link & l = *links.back();
+        uint8_t address = i + 1;
+        l.recorder.attach(l.remoteBoard.pin(hwlib::host::pins::d9));
+        channel.attach(l.carBoard.pin(hwlib::host::pins::d2));
+
+        hwlib::host::board_scope remoteScope(l.remoteBoard);
+        l.transmitterPin.reset(new due::pin_out(due::pins::d9));
+        l.message.reset(new constructMessage(*l.transmitterPin, address));
+        l.keepAlive.reset(new Transmit433mhzController(*l.transmitterPin));
+        l.slots.reset(new slotScheduler(i, s.cars));
+        if (s.tdma) {
+            l.message->setScheduler(*l.slots);
+        }
+        // the remotes are not switched on at the same moment
+        hwlib::wait_us(std::uniform_int_distribution<uint32_t>(0, 300000)(random));
+
+        hwlib::host::board_scope carScope(l.carBoard);
+        l.receiverPin.reset(new due::pin_in(due::pins::d2));
+        l.receiver.reset(new Receiver433mhz(*l.receiverPin, address));
+    }
+
+    // a frame with its keepalives is well below 200 edges
+    std::vector<uint32_t> captureBuffer(s.capture ? s.frames * (200 + 16 * s.keepalive) : 1);
+    pulseCapture capture(captureBuffer.data(), captureBuffer.size());
+    if (s.capture) {
+        links[0]->receiver->setCapture(capture);
+        // the edges go just before the clock read that timestamps them
+        channel.setGrid(1000, links[0]->carBoard.cost.clock_read_ns % 1000);
+    }
+
+    unsigned long frames = 0, good = 0, falseAccepts = 0, accepts = 0;
+    uint_fast64_t latencySum = 0, latencyMin = UINT64_MAX, latencyMax = 0;
+    uint_fast64_t airtime = 0;
+    std::vector<pulse> pending;
+
+    for (frames = 0; frames < s.frames; frames++) {
+        // the remote that is furthest behind sends the next frame
+        link & l = **std::min_element(links.begin(), links.end(), [](const std::unique_ptr<link> & a, const std::unique_ptr<link> & b) {
+            return a->remoteBoard.now_ns() < b->remoteBoard.now_ns();
+        });
+        command sent{ (bool) (random() & 1), (bool) (random() & 1), axis(random), axis(random) };
+        command expected{ sent.motorDir, sent.servoDir,
+                          constructMessage::adapter(sent.Y, 0, 4095, 0, 1023),
+                          constructMessage::adapter(sent.X, 0, 4095, 0, 511) };
+        {
+            hwlib::host::board_scope scope(l.remoteBoard);
+            for (unsigned long k = 0; k < s.keepalive; k++) {
+                l.keepAlive->keepAlive();
+            }
+            l.message->setMotorDir(sent.motorDir);
+            l.message->setServoDir(sent.servoDir);
+            l.message->setY(sent.Y);
+            l.message->setX(sent.X);
+            l.message->makeMessage();
+            hwlib::wait_us(s.gapMs * 1000);
+        }
+        auto pulses = l.recorder.take();
+        if (!pulses.empty()) {
+            // with a scheduler the frame does not start right away, the last MESSAGE_BYTES * 8 pulses are the frame
+            size_t first = pulses.size() > constructMessage::MESSAGE_BYTES * 8 ? pulses.size() - constructMessage::MESSAGE_BYTES * 8 : 0;
+            l.inFlight.push_back(sentFrame{ expected, pulses[first].rise });
+            airtime += pulses.back().fall - pulses[first].rise;
+        }
+        l.sent++;
+        pending.insert(pending.end(), pulses.begin(), pulses.end());
+
+        // the air up to the remote that is furthest behind is complete now
+        uint_fast64_t until = UINT64_MAX;
+        for (auto & other : links) {
+            until = std::min(until, other->remoteBoard.now_ns());
+        }
+        if (frames + 1 == s.frames) {
+            until = 0;
+            for (auto & other : links) {
+                until = std::max(until, other->remoteBoard.now_ns());
+            }
+        }
+        std::sort(pending.begin(), pending.end(), [](const pulse & a, const pulse & b) {
+            return a.rise < b.rise;
+        });
+        auto split = std::partition_point(pending.begin(), pending.end(), [until](const pulse & p) {
+            return p.fall <= until;
+        });
+        channel.feed(std::vector<pulse>(pending.begin(), split), until);
+        pending.erase(pending.begin(), split);
+
+        // let the cars catch up with the air
+        for (auto & car : links) {
+            hwlib::host::board_scope scope(car->carBoard);
+            while (car->carBoard.now_ns() < until) {
+                car->receiver->messageLoop();
+                if (!car->receiver->messageAvailable()) {
+                    continue;
+                }
+                accepts++;
+                car->accepted++;
+                command received{ car->receiver->getMotorDir(), car->receiver->getServoDir(),
+                                  car->receiver->getY(), car->receiver->getX() };
+                auto match = std::find_if(car->inFlight.begin(), car->inFlight.end(), [&](const sentFrame & f) {
+                    return f.expected == received;
+                });
+                if (match == car->inFlight.end()) {
+                    falseAccepts++;
+                    continue;
+                }
+                car->good++;
+                good++;
+                uint_fast64_t latency = car->carBoard.now_ns() - match->start;
+                latencySum += latency;
+                latencyMin = std::min(latencyMin, latency);
+                latencyMax = std::max(latencyMax, latency);
+                // older frames that did not arrive by now never will
+                car->inFlight.erase(car->inFlight.begin(), match + 1);
+            }
+        }
+    }
+
+    uint_fast64_t end = 0;
+    for (auto & l : links) {
+        end = std::max(end, l->remoteBoard.now_ns());
+    }
+    double seconds = end / 1e9;
+    std::printf("frames sent        %lu in %.3f s virtual time\n", frames, seconds);
+    std::printf("frames per second  %.1f sent, %.1f good\n", frames / seconds, good / seconds);
+    std::printf("frame error rate   %.5f\n", frames ? 1.0 - (double) good / frames : 0.0);
+    std::printf("false accept rate  %.5f (%lu of %lu accepted frames)\n",
+                accepts ? (double) falseAccepts / accepts : 0.0, falseAccepts, accepts);
+    if (good) {
+        std::printf("latency            %.3f ms mean, %.3f ms min, %.3f ms max\n",
+                    latencySum / 1e6 / good, latencyMin / 1e6, latencyMax / 1e6);
+    }
+    std::printf("airtime            %.3f ms per frame\n", frames ? airtime / 1e6 / frames : 0.0);
+    std::printf("channel            %lu flipped, %lu dropped, %lu stray pulses\n",
+                (unsigned long) channel.flipped, (unsigned long) channel.dropped, (unsigned long) channel.stray);
+    if (links.size() > 1) {
+        for (size_t i = 0; i < links.size(); i++) {
+            std::printf("car %-3zu            %lu sent, %lu good, %.1f good per second\n",
+                        i + 1, links[i]->sent, links[i]->good, links[i]->good / seconds);
+        }
+    }
+    if (s.capture) {
+        if (capture.full()) {
+            std::fprintf(stderr, "channelsim: the capture overflowed, a replay will not see the first edges\n");
+        }
+        std::ofstream out(s.capture);
+        capture.dump(out);
+        // host/replay checks that it accepts as many frames for address 1, and runs until the same time
+        out << "capture-expect 1 " << links[0]->accepted << " " << links[0]->carBoard.now_ns() << "\n";
+    }
+#ifdef RCCAR_TRACE
+    // all boards share one timebase, so encode-to-decode latency can be read straight from the trace
+    latencyTrace::dump();
+#endif
+}
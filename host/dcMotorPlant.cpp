@@ -0,0 +1,98 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "dcMotorPlant.hpp"
+
+#include <cmath>
+
+dcMotorPlant::dcMotorPlant(hwlib::host::board & board, const virtualPCA9685 & chip,
+                           uint8_t pwmPin, uint8_t forwardPin, uint8_t backwardPin,
+                           const dcMotorParameters & parameters):
+    board(board),
+    chip(chip),
+    pwmPin(pwmPin),
+    forwardPin(forwardPin),
+    backwardPin(backwardPin),
+    parameters(parameters),
+    now(board.now_ns())
+{}
+
+void dcMotorPlant::integrate(double seconds) {
+    const dcMotorParameters & p = parameters;
+    // a direction pin counts as high when it is high more than half the period
+    bool forward = pins[forwardPin].ticks > 2048;
+    bool backward = pins[backwardPin].ticks > 2048;
+    double duty = pins[pwmPin].ticks / 4096.0;
+
+    double torque = 0;
+    if (duty > 0 && forward != backward) {
+        double volts = (forward ? 1 : -1) * duty * p.batteryV;
+        torque = p.ke * (volts - p.ke * omega) / p.resistance;
+    } else if (duty > 0) {
+        // both low sides on: the motor is shorted, its own back emf brakes it
+        torque = -p.ke * p.ke * omega / p.resistance * duty;
+    }
+    // with the enables low the bridge is open and the motor coasts, no current flows
+    torque -= p.viscous * omega + p.load;
+
+    // coulomb friction holds the shaft as long as the rest of the torque cannot overcome it
+    if (omega == 0 && std::fabs(torque) <= p.friction) {
+        return;
+    }
+    double next = omega + (torque - std::copysign(p.friction, omega != 0 ? omega : torque)) / p.inertia * seconds;
+    if (omega != 0 && (next > 0) != (omega > 0)) {
+        next = 0;
+    }
+    angle += (omega + next) / 2 * seconds;
+    omega = next;
+}
+
+void dcMotorPlant::advanceTo(uint_fast64_t ns) {
+    auto & log = chip.changes();
+    while (now < ns) {
+        // apply the output changes up to now, then integrate up to the next change or step
+        while (logIndex < log.size() && log[logIndex].ns <= now) {
+            pins[log[logIndex].channel] = log[logIndex].value;
+            logIndex++;
+        }
+        uint_fast64_t until = now + STEP_NS < ns ? now + STEP_NS : ns;
+        if (logIndex < log.size() && log[logIndex].ns < until) {
+            until = log[logIndex].ns;
+        }
+        integrate((until - now) / 1e9);
+        now = until;
+    }
+}
+
+double dcMotorPlant::countsPerSecond() const {
+    return omega / (2 * M_PI * parameters.gear) * parameters.countsPerRev;
+}
+
+double dcMotorPlant::counts() const {
+    return angle / (2 * M_PI * parameters.gear) * parameters.countsPerRev;
+}
+
+void dcMotorPlant::attachTachometer(hwlib::host::digital_pin & pin) {
+    pin.source = [this](uint_fast64_t ns) {
+        advanceTo(ns);
+        return ((int64_t) std::floor(counts()) & 1) != 0;
+    };
+}
+
+void dcMotorPlant::attachEncoder(hwlib::host::digital_pin & a, hwlib::host::digital_pin & b) {
+    // gray code 00 01 11 10 going forward, with A as the high bit
+    a.source = [this](uint_fast64_t ns) {
+        advanceTo(ns);
+        return (((int64_t) std::floor(counts()) & 3) >> 1) != 0;
+    };
+    b.source = [this](uint_fast64_t ns) {
+        advanceTo(ns);
+        return ((((int64_t) std::floor(counts()) & 3) + 1) >> 1 & 1) != 0;
+    };
+}
@@ -0,0 +1,109 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_DCMOTORPLANT_HPP
+#define RCCAR_DCMOTORPLANT_HPP
+
+#include "hwlib.hpp"
+#include "virtualPCA9685.hpp"
+
+/**
+ * \struct dcMotorParameters. a brushed motor driving the car through a gearbox
+ * the defaults are a 540 size motor on 2S lipo, with the inertia of a 1.5kg car reflected to the motor
+ */
+struct dcMotorParameters {
+    double batteryV   = 7.4;        /**< voltage at the IBT_2 */
+    double resistance = 0.12;       /**< ohm, winding, brushes and driver */
+    double ke         = 0.0034;     /**< back emf in V s/rad, also the torque constant in Nm/A */
+    double inertia    = 2e-5;       /**< kg m2 at the motor shaft */
+    double viscous    = 1e-6;       /**< Nm s/rad */
+    double friction   = 0.005;      /**< Nm, coulomb friction of the motor and the drivetrain */
+    double load       = 0;          /**< Nm at the motor shaft, a hill, positive works against forward */
+    double gear       = 10;         /**< motor turns per turn of the shaft the sensor is on */
+    uint16_t countsPerRev = 8;      /**< sensor counts per turn of its shaft */
+};
+
+/**
+ * \class dcMotorPlant. a DC motor behind an IBT_2, driven by the pins of a virtualPCA9685
+ * follows the output log of the chip, so the motor sees every change at the moment it happened.
+ * the PWM is averaged and the inductance is left out, both are fast compared to the mechanics.
+ * the shaft position is available as a tachometer or a quadrature encoder on pins of the board.
+ */
+class dcMotorPlant {
+private:
+    hwlib::host::board & board;
+    const virtualPCA9685 & chip;
+    uint8_t pwmPin, forwardPin, backwardPin;
+    dcMotorParameters parameters;
+
+    virtualPCA9685::output pins[16];
+    size_t logIndex = 0;
+    uint_fast64_t now = 0;
+    double omega = 0;           /**< motor speed in rad/s */
+    double angle = 0;           /**< motor position in rad */
+
+    void integrate(double seconds);
+
+public:
+    static constexpr uint32_t STEP_NS = 20000;    /**< integration step */
+
+    /**
+     * \brief Standard constructor
+     *
+     * @param board board the chip is on, for the time
+     * @param chip the PCA9685 the IBT_2 is connected to
+     * @param pwmPin, forwardPin, backwardPin pins of the IBT_2 on the chip, as in IBT_2
+     * @param parameters see dcMotorParameters
+     */
+    dcMotorPlant(hwlib::host::board & board, const virtualPCA9685 & chip,
+                 uint8_t pwmPin, uint8_t forwardPin, uint8_t backwardPin,
+                 const dcMotorParameters & parameters = dcMotorParameters());
+
+    /**
+     * \brief run the model up to a point in time
+     */
+    void advanceTo(uint_fast64_t ns);
+
+    /**
+     * \brief drive a pin of the board with a tachometer signal, every count toggles it
+     */
+    void attachTachometer(hwlib::host::digital_pin & pin);
+
+    /**
+     * \brief drive two pins of the board with a quadrature encoder signal, B leads A going forward.
+     * every count is an edge on one of the pins, so there are countsPerRev / 4 cycles per turn
+     */
+    void attachEncoder(hwlib::host::digital_pin & a, hwlib::host::digital_pin & b);
+
+    /**
+     * \brief change the parameters while running, for a hill or a sagging battery
+     */
+    dcMotorParameters & settings() {
+        return parameters;
+    }
+
+    /**
+     * \brief true speed of the motor in rad/s
+     */
+    double motorSpeed() const {
+        return omega;
+    }
+
+    /**
+     * \brief true speed in counts per second of the sensor, what a perfect sensor would measure
+     */
+    double countsPerSecond() const;
+
+    /**
+     * \brief position in sensor counts
+     */
+    double counts() const;
+};
+
+#endif //RCCAR_DCMOTORPLANT_HPP
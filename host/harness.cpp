@@ -0,0 +1,190 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+// Linked into the host builds of mainCar.cpp and mainRemote.cpp. Those mains
+// loop forever, so this file sets up the simulated board before main() runs
+// and ends the program once the requested amount of virtual time has passed.
+//
+// environment variables:
+//   RCCAR_HOST_RUN_MS    virtual milliseconds to run, default 2000
+//   RCCAR_HOST_STICK_X   12 bit adc value on a0, default 2048
+//   RCCAR_HOST_STICK_Y   12 bit adc value on a1, default 2048
+//   RCCAR_HOST_STEP_MS   when set, a1 stays at 2048 until this moment and then
+//                        jumps to RCCAR_HOST_STICK_Y. the report gives the time
+//                        until the first drive frame with a throttle was on air
+//   RCCAR_HOST_NOISE     when set, both adc inputs get uniform noise of plus and
+//                        minus this many steps
+
+#include "hwlib.hpp"
+#include "virtualPCA9685.hpp"
+#include "linkFrames.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+namespace {
+
+using hwlib::host::active_board;
+
+const char * pinNames[] = {
+    "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d7", "d8", "d9",
+    "d10", "d11", "d12", "d13", "d14", "d15", "d16", "d17", "d18", "d19",
+    "d20", "d21", "d22", "d23", "d24", "d25", "d26", "d27", "d28", "d29",
+    "d30", "d31", "d32", "d33", "d34", "d35", "d36", "d37", "d38", "d39",
+    "d40", "d41", "d42", "d43", "d44", "d45", "d46", "d47", "d48", "d49",
+    "d50", "d51", "d52", "d53",
+    "a0", "a1", "a2", "a3", "a4", "a5", "a6", "a7", "a8", "a9", "a10", "a11",
+    "dac0", "dac1", "canrx", "cantx",
+    "scl", "sda", "scl1", "sda1",
+    "tx", "rx", "led"
+};
+
+unsigned long environment(const char * name, unsigned long otherwise) {
+    const char * value = std::getenv(name);
+    return value ? std::strtoul(value, nullptr, 0) : otherwise;
+}
+
+class harness {
+private:
+    std::chrono::steady_clock::time_point wallStart;
+
+    // the car code is calibrated for a chip whose oscillator runs at 27MHz
+    virtualPCA9685 pca{active_board(), 0x40, 27000000};
+
+    // frames the remote puts on air, decoded from the pulses on the transmitter pin
+    uint_fast64_t stepNs = 0;
+    uint_fast64_t risingNs = 0, fallingNs = 0;
+    uint64_t bits = 0;
+    uint8_t bitCount = 0;
+    uint_fast64_t throttleNs = 0;       /**< end of the first drive frame with a throttle after the step */
+    uint_fast32_t driveFrames = 0, auxFrames = 0;
+    uint_fast64_t carrierNs = 0;        /**< time the transmitter was on */
+
+    std::mt19937 noise{1};
+
+    void transmitterEdge(bool level, uint_fast64_t ns) {
+        if (level) {
+            // a pause longer than a few bits ends a message
+            if (ns - fallingNs > 1500000) {
+                bits = 0;
+                bitCount = 0;
+            }
+            risingNs = ns;
+            return;
+        }
+        fallingNs = ns;
+        carrierNs += ns - risingNs;
+        bits = bits << 1 | (ns - risingNs > 300000);
+        if (++bitCount < 8 * linkFrames::FRAME_BYTES) {
+            return;
+        }
+        uint32_t frame = (uint32_t) bits;
+        bitCount = 0;
+        if (linkFrames::isDrive(frame)) {
+            driveFrames++;
+        } else {
+            auxFrames++;
+        }
+        if (stepNs && !throttleNs && ns > stepNs && linkFrames::isDrive(frame)
+            && linkFrames::driveFrame::unpack<linkFrames::y>(frame)) {
+            throttleNs = ns;
+        }
+    }
+
+    void report() {
+        auto & b = active_board();
+        double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+        double simulated = b.now_ns() / 1e9;
+
+        std::fprintf(stderr, "virtual time %.3f s, wall time %.3f s, %.1fx real time\n",
+                     simulated, wall, wall > 0 ? simulated / wall : 0.0);
+        for (size_t i = 0; i < sizeof(pinNames) / sizeof(pinNames[0]); i++) {
+            auto & p = b.pin(static_cast<hwlib::host::pins>(i));
+            if (p.edges || p.reads) {
+                std::fprintf(stderr, "pin %-5s %10lu edges %10lu reads\n", pinNames[i],
+                             (unsigned long) p.edges, (unsigned long) p.reads);
+            }
+        }
+        for (size_t i = 0; i < static_cast<size_t>(hwlib::host::ad_pins::SIZE_THIS_IS_NOT_A_PIN); i++) {
+            auto & a = b.adc(static_cast<hwlib::host::ad_pins>(i));
+            if (a.samples) {
+                std::fprintf(stderr, "adc a%-4zu %10lu samples\n", i, (unsigned long) a.samples);
+            }
+        }
+        if (driveFrames || auxFrames) {
+            std::fprintf(stderr, "remote sent %lu drive frames %lu aux frames, carrier on %.1f%% of the time\n",
+                         (unsigned long) driveFrames, (unsigned long) auxFrames, carrierNs * 100.0 / b.now_ns());
+        }
+        if (stepNs) {
+            if (throttleNs) {
+                std::fprintf(stderr, "stick step at %.1f ms, first throttle frame on air %.1f ms later\n",
+                             stepNs / 1e6, (throttleNs - stepNs) / 1e6);
+            } else {
+                std::fprintf(stderr, "stick step at %.1f ms, no throttle frame on air\n", stepNs / 1e6);
+            }
+        }
+        std::fprintf(stderr, "i2c %lu writes %lu reads %lu bytes out %lu bytes in %lu nacks, busy %.3f s\n",
+                     (unsigned long) b.i2c.write_transactions, (unsigned long) b.i2c.read_transactions,
+                     (unsigned long) b.i2c.bytes_written, (unsigned long) b.i2c.bytes_read,
+                     (unsigned long) b.i2c.nacks, b.i2c.busy_ns / 1e9);
+        if (pca.traffic().writeTransactions) {
+            std::fprintf(stderr, "pca %s at %.2f Hz, %lu output changes\n", pca.running() ? "running" : "stopped",
+                         pca.frequencyHz(), (unsigned long) pca.traffic().outputChanges);
+            for (uint8_t n = 0; n < 16; n++) {
+                if (pca.channel(n).ticks) {
+                    std::fprintf(stderr, "pca channel %-2d %4d ticks, %7.1f us\n", n, pca.channel(n).ticks, pca.pulseWidthUs(n));
+                }
+            }
+        }
+    }
+
+public:
+    harness():
+        wallStart(std::chrono::steady_clock::now())
+    {
+        auto & b = active_board();
+        b.attach(pca);
+        uint_fast32_t x = environment("RCCAR_HOST_STICK_X", 2048);
+        uint_fast32_t y = environment("RCCAR_HOST_STICK_Y", 2048);
+        b.adc(hwlib::host::ad_pins::a0).value = x;
+        b.adc(hwlib::host::ad_pins::a1).value = y;
+        stepNs = (uint_fast64_t) environment("RCCAR_HOST_STEP_MS", 0) * 1000000;
+        int noiseSteps = environment("RCCAR_HOST_NOISE", 0);
+        if (stepNs || noiseSteps) {
+            auto noisy = [this, noiseSteps](int value) -> uint_fast32_t {
+                if (noiseSteps) {
+                    value += std::uniform_int_distribution<int>(-noiseSteps, noiseSteps)(noise);
+                }
+                return value < 0 ? 0 : (value > 4095 ? 4095 : value);
+            };
+            b.adc(hwlib::host::ad_pins::a0).source = [noisy, x](uint_fast64_t) {
+                return noisy(x);
+            };
+            b.adc(hwlib::host::ad_pins::a1).source = [this, noisy, y](uint_fast64_t ns) {
+                return noisy(stepNs && ns < stepNs ? 2048 : y);
+            };
+        }
+        b.pin(hwlib::host::pins::d9).sink = [this](bool level, uint_fast64_t ns) {
+            transmitterEdge(level, ns);
+        };
+
+        uint_fast64_t runNs = (uint_fast64_t) environment("RCCAR_HOST_RUN_MS", 2000) * 1000000;
+        b.clock.set_deadline_ns(runNs, [this]() {
+            report();
+            std::fflush(stdout);
+            std::exit(0);
+        });
+    }
+};
+
+harness instance;
+
+} // namespace
@@ -0,0 +1,320 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "hwlib.hpp"
+
+namespace hwlib {
+
+namespace host {
+
+void virtual_clock::advance_ns(uint_fast64_t delta) {
+    ns += delta;
+    if (ns >= deadline && on_deadline) {
+        // clear first, the callback may well advance the clock itself
+        auto f = on_deadline;
+        on_deadline = nullptr;
+        deadline = UINT64_MAX;
+        f();
+    }
+}
+
+void virtual_clock::advance_to_ns(uint_fast64_t t) {
+    if (t > ns) {
+        advance_ns(t - ns);
+    }
+}
+
+void virtual_clock::set_deadline_ns(uint_fast64_t t, std::function<void()> f) {
+    deadline = t;
+    on_deadline = f;
+}
+
+static board * current_board = nullptr;
+
+board & active_board() {
+    // constructed on first use, static objects in other files may need it
+    static board default_board;
+    return current_board ? *current_board : default_board;
+}
+
+board_scope::board_scope(board & b):
+    previous(current_board)
+{
+    current_board = &b;
+}
+
+board_scope::~board_scope() {
+    current_board = previous;
+}
+
+void i2c_bus_sim::charge(uint_fast32_t bits) {
+    auto & b = active_board();
+    uint_fast64_t ns = (uint_fast64_t) bits * b.cost.i2c_bit_ns;
+    b.i2c.busy_ns += ns;
+    b.clock.advance_ns(ns);
+}
+
+void i2c_bus_sim::write_start(uint_fast8_t address) {
+    auto & b = active_board();
+    // start condition plus address byte and ack
+    charge(10);
+    b.i2c.write_transactions++;
+    current = nullptr;
+    for (auto device : b.devices) {
+        if (device->acknowledges(address)) {
+            current = device;
+            break;
+        }
+    }
+    if (current) {
+        current->write_start();
+    } else {
+        b.i2c.nacks++;
+    }
+}
+
+void i2c_bus_sim::write_byte(uint8_t data) {
+    charge(9);
+    active_board().i2c.bytes_written++;
+    if (current) {
+        current->write_byte(data);
+    }
+}
+
+void i2c_bus_sim::read_start(uint_fast8_t address) {
+    auto & b = active_board();
+    charge(10);
+    b.i2c.read_transactions++;
+    current = nullptr;
+    for (auto device : b.devices) {
+        if (device->acknowledges(address)) {
+            current = device;
+            break;
+        }
+    }
+    if (current) {
+        current->read_start();
+    } else {
+        b.i2c.nacks++;
+    }
+}
+
+uint8_t i2c_bus_sim::read_byte() {
+    charge(9);
+    active_board().i2c.bytes_read++;
+    // an idle bus reads as all ones
+    return current ? current->read_byte() : 0xFF;
+}
+
+void i2c_bus_sim::stop() {
+    charge(1);
+    if (current) {
+        current->stop();
+        current = nullptr;
+    }
+}
+
+} // namespace host
+
+uint_fast64_t now_us() {
+    return now_ns() / 1000;
+}
+
+uint_fast64_t now_ns() {
+    auto & b = host::active_board();
+    b.clock.advance_ns(b.cost.clock_read_ns);
+    return b.clock.now_ns();
+}
+
+void wait_ns(int_fast32_t n) {
+    if (n > 0) {
+        host::active_board().clock.advance_ns(n);
+    }
+}
+
+void wait_us(int_fast32_t n) {
+    if (n > 0) {
+        host::active_board().clock.advance_ns((uint_fast64_t) n * 1000);
+    }
+}
+
+void wait_ms(int_fast32_t n) {
+    if (n > 0) {
+        host::active_board().clock.advance_ns((uint_fast64_t) n * 1000000);
+    }
+}
+
+namespace host {
+
+bool uart_ready() {
+    auto & b = active_board();
+    b.clock.advance_ns(b.cost.pin_read_ns);
+    return b.clock.now_ns() >= b.uart_busy_until;
+}
+
+void uart_put(uint8_t byte) {
+    auto & b = active_board();
+    b.clock.advance_ns(b.cost.pin_write_ns);
+    b.uart_busy_until = b.clock.now_ns() + b.cost.uart_byte_ns;
+    std::cout.put((char) byte);
+}
+
+} // namespace host
+
+i2c_write_transaction::i2c_write_transaction(i2c_bus & bus, uint_fast8_t address):
+    bus(bus)
+{
+    bus.write_start(address);
+}
+
+i2c_write_transaction::~i2c_write_transaction() {
+    bus.stop();
+}
+
+void i2c_write_transaction::write(uint8_t data) {
+    bus.write_byte(data);
+}
+
+void i2c_write_transaction::write(const uint8_t data[], size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        bus.write_byte(data[i]);
+    }
+}
+
+i2c_read_transaction::i2c_read_transaction(i2c_bus & bus, uint_fast8_t address):
+    bus(bus)
+{
+    bus.read_start(address);
+}
+
+i2c_read_transaction::~i2c_read_transaction() {
+    bus.stop();
+}
+
+uint8_t i2c_read_transaction::read_byte() {
+    return bus.read_byte();
+}
+
+void i2c_read_transaction::read(uint8_t & data) {
+    data = bus.read_byte();
+}
+
+void i2c_read_transaction::read(uint8_t data[], size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        data[i] = bus.read_byte();
+    }
+}
+
+} // namespace hwlib
+
+namespace due {
+
+using hwlib::host::active_board;
+
+pin_in::pin_in(pins name):
+    pin(active_board().pin(name))
+{}
+
+bool pin_in::read() {
+    auto & b = active_board();
+    b.clock.advance_ns(b.cost.pin_read_ns);
+    pin.reads++;
+    if (pin.source) {
+        pin.level = pin.source(b.clock.now_ns());
+    }
+    return pin.level;
+}
+
+pin_out::pin_out(pins name):
+    pin(active_board().pin(name))
+{}
+
+void pin_out::write(bool x) {
+    auto & b = active_board();
+    b.clock.advance_ns(b.cost.pin_write_ns);
+    if (x != pin.level) {
+        pin.edges++;
+    }
+    pin.level = x;
+    if (pin.sink) {
+        pin.sink(x, b.clock.now_ns());
+    }
+}
+
+pin_in_out::pin_in_out(pins name):
+    pin(active_board().pin(name))
+{}
+
+bool pin_in_out::read() {
+    auto & b = active_board();
+    b.clock.advance_ns(b.cost.pin_read_ns);
+    pin.reads++;
+    if (pin.source) {
+        pin.level = pin.source(b.clock.now_ns());
+    }
+    return pin.level;
+}
+
+void pin_in_out::write(bool x) {
+    auto & b = active_board();
+    b.clock.advance_ns(b.cost.pin_write_ns);
+    if (x != pin.level) {
+        pin.edges++;
+    }
+    pin.level = x;
+    if (pin.sink) {
+        pin.sink(x, b.clock.now_ns());
+    }
+}
+
+pin_oc::pin_oc(pins name):
+    pin(active_board().pin(name))
+{
+    // open collector pins float high
+    pin.level = true;
+}
+
+bool pin_oc::read() {
+    auto & b = active_board();
+    b.clock.advance_ns(b.cost.pin_read_ns);
+    pin.reads++;
+    if (pin.source) {
+        pin.level = pin.source(b.clock.now_ns());
+    }
+    return pin.level;
+}
+
+void pin_oc::write(bool x) {
+    auto & b = active_board();
+    b.clock.advance_ns(b.cost.pin_write_ns);
+    if (x != pin.level) {
+        pin.edges++;
+    }
+    pin.level = x;
+    if (pin.sink) {
+        pin.sink(x, b.clock.now_ns());
+    }
+}
+
+pin_adc::pin_adc(ad_pins name):
+    hwlib::adc(12),
+    pin(active_board().adc(name))
+{}
+
+pin_adc::adc_value_type pin_adc::read() {
+    auto & b = active_board();
+    b.clock.advance_ns(b.cost.adc_read_ns);
+    pin.samples++;
+    if (pin.source) {
+        pin.value = pin.source(b.clock.now_ns());
+    }
+    return pin.value & adc_max_value;
+}
+
+} // namespace due
@@ -0,0 +1,521 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_HOST_HWLIB_HPP
+#define RCCAR_HOST_HWLIB_HPP
+
+// ==========================================================================
+//
+// host (Linux) stand-in for the parts of hwlib used by this project
+//
+// ==========================================================================
+//
+// The files in lib/ include <hwlib.hpp>. When they are compiled with
+// -I host this header is found instead of the real hwlib, so the firmware
+// builds as a normal host executable. Time is virtual: wait_us() advances
+// a clock instead of sleeping and every pin, adc, clock or i2c access costs
+// a configurable amount of virtual time, so a simulated second runs in a
+// fraction of a real one.
+//
+// Code that needs to know it is running on the host can test HWLIB_HOST.
+
+#define HWLIB_HOST
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace hwlib {
+
+namespace host {
+
+/**
+ * \class virtual_clock. monotonic nanosecond clock that only moves when it is told to
+ */
+class virtual_clock {
+private:
+    uint_fast64_t ns = 0;                               /**< current virtual time */
+    uint_fast64_t deadline = UINT64_MAX;                /**< time at which on_deadline is called */
+    std::function<void()> on_deadline;                  /**< called once when the deadline is passed */
+
+public:
+    /**
+     * \brief current virtual time in nanoseconds
+     */
+    uint_fast64_t now_ns() const {
+        return ns;
+    }
+
+    /**
+     * \brief move the clock forward
+     *
+     * @param delta number of nanoseconds to advance
+     */
+    void advance_ns(uint_fast64_t delta);
+
+    /**
+     * \brief move the clock forward to an absolute time, never backwards
+     *
+     * @param t time in nanoseconds to advance to
+     */
+    void advance_to_ns(uint_fast64_t t);
+
+    /**
+     * \brief register a function that is called once the clock passes a point in time
+     * this is used by the harness to end the otherwise endless main loops
+     *
+     * @param t deadline in nanoseconds
+     * @param f function to call
+     */
+    void set_deadline_ns(uint_fast64_t t, std::function<void()> f);
+};
+
+/**
+ * \struct cost_model. virtual time charged for each hardware access
+ * the defaults roughly follow an Arduino Due running hwlib with a bit banged i2c bus
+ */
+struct cost_model {
+    uint_fast32_t pin_read_ns   = 250;      /**< one pin_in / pin_oc read */
+    uint_fast32_t pin_write_ns  = 250;      /**< one pin_out / pin_oc write */
+    uint_fast32_t clock_read_ns = 250;      /**< one now_us() call */
+    uint_fast32_t adc_read_ns   = 2000;     /**< one adc conversion */
+    uint_fast32_t i2c_bit_ns    = 10000;    /**< one bit on the i2c bus, 100 kHz */
+    uint_fast32_t uart_byte_ns  = 86806;    /**< one byte out of the uart, 10 bits at 115200 baud */
+};
+
+/**
+ * \struct digital_pin. the simulated state of one digital pin of a board
+ */
+struct digital_pin {
+    bool level = false;                                         /**< level last written, or read when there is no source */
+    std::function<bool(uint_fast64_t ns)> source;               /**< when set, drives the level seen by reads */
+    std::function<void(bool level, uint_fast64_t ns)> sink;     /**< when set, observes every write */
+    uint_fast32_t edges = 0;                                    /**< number of level changes written */
+    uint_fast32_t reads = 0;                                    /**< number of reads */
+};
+
+/**
+ * \struct analog_pin. the simulated state of one adc input of a board
+ */
+struct analog_pin {
+    uint_fast32_t value = 2048;                                 /**< 12 bit value returned when there is no source */
+    std::function<uint_fast32_t(uint_fast64_t ns)> source;      /**< when set, provides the sampled value */
+    uint_fast32_t samples = 0;                                  /**< number of conversions */
+};
+
+/**
+ * \class i2c_device. a simulated chip on the i2c bus of a board
+ * the bus calls these functions for every transaction addressed to the device
+ */
+class i2c_device {
+public:
+    /**
+     * \brief whether the device answers to the given 7 bit address
+     */
+    virtual bool acknowledges(uint_fast8_t address) const = 0;
+
+    /**
+     * \brief a write transaction to this device starts
+     */
+    virtual void write_start() {}
+
+    /**
+     * \brief one byte written by the bus master
+     */
+    virtual void write_byte(uint8_t b) = 0;
+
+    /**
+     * \brief a read transaction from this device starts
+     */
+    virtual void read_start() {}
+
+    /**
+     * \brief one byte read by the bus master
+     */
+    virtual uint8_t read_byte() = 0;
+
+    /**
+     * \brief the current transaction ends with a stop condition
+     */
+    virtual void stop() {}
+};
+
+/**
+ * \struct i2c_statistics. traffic counters of a simulated i2c bus
+ */
+struct i2c_statistics {
+    uint_fast32_t write_transactions = 0;   /**< number of write transactions */
+    uint_fast32_t read_transactions  = 0;   /**< number of read transactions */
+    uint_fast32_t bytes_written      = 0;   /**< data bytes written, address bytes excluded */
+    uint_fast32_t bytes_read         = 0;   /**< data bytes read, address bytes excluded */
+    uint_fast32_t nacks              = 0;   /**< transactions nobody acknowledged */
+    uint_fast64_t busy_ns            = 0;   /**< virtual time spent on the bus */
+};
+
+/**
+ * \brief pin numbers of a simulated board, the same names as the Arduino Due target
+ */
+enum class pins {
+    d0, d1, d2, d3, d4, d5, d6, d7, d8, d9,
+    d10, d11, d12, d13, d14, d15, d16, d17, d18, d19,
+    d20, d21, d22, d23, d24, d25, d26, d27, d28, d29,
+    d30, d31, d32, d33, d34, d35, d36, d37, d38, d39,
+    d40, d41, d42, d43, d44, d45, d46, d47, d48, d49,
+    d50, d51, d52, d53,
+    a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11,
+    dac0, dac1, canrx, cantx,
+    scl, sda, scl1, sda1,
+    tx, rx, led,
+    SIZE_THIS_IS_NOT_A_PIN
+};
+
+/**
+ * \brief adc inputs of a simulated board
+ */
+enum class ad_pins {
+    a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11,
+    SIZE_THIS_IS_NOT_A_PIN
+};
+
+/**
+ * \class board. everything a simulated microcontroller sees: its clock, pins, adc inputs and i2c devices
+ * several boards can exist side by side, for instance a remote and a car, each with its own clock.
+ * the hwlib functions and pins always work on the active board, see board_scope.
+ */
+class board {
+public:
+    virtual_clock clock;                /**< the time of this board */
+    cost_model cost;                    /**< virtual time charged per hardware access */
+    i2c_statistics i2c;                 /**< traffic on the i2c bus of this board */
+    std::vector<i2c_device *> devices;  /**< chips on the i2c bus of this board */
+    uint_fast64_t uart_busy_until = 0;  /**< time the uart has sent the last byte it was given */
+
+    /**
+     * \brief the simulated state of a digital pin
+     */
+    digital_pin & pin(pins p) {
+        return digital[static_cast<size_t>(p)];
+    }
+
+    /**
+     * \brief the simulated state of an adc input
+     */
+    analog_pin & adc(ad_pins p) {
+        return analog[static_cast<size_t>(p)];
+    }
+
+    /**
+     * \brief connect a simulated chip to the i2c bus
+     */
+    void attach(i2c_device & device) {
+        devices.push_back(&device);
+    }
+
+    /**
+     * \brief current time of this board in nanoseconds
+     */
+    uint_fast64_t now_ns() const {
+        return clock.now_ns();
+    }
+
+private:
+    digital_pin digital[static_cast<size_t>(pins::SIZE_THIS_IS_NOT_A_PIN)];
+    analog_pin analog[static_cast<size_t>(ad_pins::SIZE_THIS_IS_NOT_A_PIN)];
+};
+
+/**
+ * \brief the board the hwlib functions currently act on
+ */
+board & active_board();
+
+/**
+ * \class board_scope. makes a board the active board for as long as the scope lives
+ */
+class board_scope {
+private:
+    board * previous;
+
+public:
+    board_scope(board & b);
+    ~board_scope();
+    board_scope(const board_scope &) = delete;
+    board_scope & operator=(const board_scope &) = delete;
+};
+
+} // namespace host
+
+// ==========================================================================
+//
+// timing
+//
+// ==========================================================================
+
+/**
+ * \brief current virtual time of the active board in microseconds
+ */
+uint_fast64_t now_us();
+
+/**
+ * \brief current virtual time of the active board in nanoseconds
+ */
+uint_fast64_t now_ns();
+
+/**
+ * \brief advance the virtual time of the active board
+ */
+void wait_ns(int_fast32_t n);
+void wait_us(int_fast32_t n);
+void wait_ms(int_fast32_t n);
+
+// ==========================================================================
+//
+// pins and adc
+//
+// ==========================================================================
+
+class pin_in {
+public:
+    virtual bool read() = 0;
+    virtual void refresh() {}
+};
+
+class pin_out {
+public:
+    virtual void write(bool x) = 0;
+    virtual void flush() {}
+};
+
+class pin_in_out {
+public:
+    virtual void direction_set_input() = 0;
+    virtual bool read() = 0;
+    virtual void direction_set_output() = 0;
+    virtual void write(bool x) = 0;
+    virtual void refresh() {}
+    virtual void flush() {}
+    virtual void direction_flush() {}
+};
+
+class pin_oc {
+public:
+    virtual bool read() = 0;
+    virtual void write(bool x) = 0;
+    virtual void refresh() {}
+    virtual void flush() {}
+};
+
+class adc {
+public:
+    typedef uint_fast32_t adc_value_type;
+
+    const int adc_n_bits;
+    const adc_value_type adc_max_value;
+
+    adc(int n_bits):
+        adc_n_bits(n_bits),
+        adc_max_value((1u << n_bits) - 1)
+    {}
+
+    virtual adc_value_type read() = 0;
+    virtual void refresh() {}
+};
+
+// ==========================================================================
+//
+// i2c
+//
+// ==========================================================================
+
+class i2c_bus;
+
+class i2c_write_transaction {
+private:
+    i2c_bus & bus;
+
+public:
+    i2c_write_transaction(i2c_bus & bus, uint_fast8_t address);
+    ~i2c_write_transaction();
+    i2c_write_transaction(const i2c_write_transaction &) = delete;
+
+    void write(uint8_t data);
+    void write(const uint8_t data[], size_t n);
+};
+
+class i2c_read_transaction {
+private:
+    i2c_bus & bus;
+
+public:
+    i2c_read_transaction(i2c_bus & bus, uint_fast8_t address);
+    ~i2c_read_transaction();
+    i2c_read_transaction(const i2c_read_transaction &) = delete;
+
+    uint8_t read_byte();
+    void read(uint8_t & data);
+    void read(uint8_t data[], size_t n);
+};
+
+/**
+ * \class i2c_bus. byte level i2c master
+ * transactions are started with write() and read() and end when the returned object is destroyed
+ */
+class i2c_bus {
+public:
+    virtual void write_start(uint_fast8_t address) = 0;
+    virtual void write_byte(uint8_t b) = 0;
+    virtual void read_start(uint_fast8_t address) = 0;
+    virtual uint8_t read_byte() = 0;
+    virtual void stop() = 0;
+
+    i2c_write_transaction write(uint_fast8_t address) {
+        return i2c_write_transaction(*this, address);
+    }
+
+    i2c_read_transaction read(uint_fast8_t address) {
+        return i2c_read_transaction(*this, address);
+    }
+};
+
+namespace host {
+
+/**
+ * \class i2c_bus_sim. i2c bus that delivers transactions to the devices attached to the active board
+ * every bit costs cost_model::i2c_bit_ns and all traffic is counted in board::i2c
+ */
+class i2c_bus_sim : public i2c_bus {
+private:
+    i2c_device * current = nullptr;
+
+    void charge(uint_fast32_t bits);
+
+public:
+    void write_start(uint_fast8_t address) override;
+    void write_byte(uint8_t b) override;
+    void read_start(uint_fast8_t address) override;
+    uint8_t read_byte() override;
+    void stop() override;
+};
+
+} // namespace host
+
+/**
+ * \brief the bit banged bus of the target, on the host it is a simulated bus
+ */
+class i2c_bus_bit_banged_scl_sda : public host::i2c_bus_sim {
+public:
+    i2c_bus_bit_banged_scl_sda(pin_oc &, pin_oc &) {}
+};
+
+// ==========================================================================
+//
+// console
+//
+// ==========================================================================
+
+inline std::ostream & cout = std::cout;
+
+namespace host {
+
+/**
+ * \brief whether the uart of the active board takes a byte right now, like TXRDY of the Due
+ * text through cout is not paced, only bytes through uart_put are
+ */
+bool uart_ready();
+
+/**
+ * \brief send a byte from the uart of the active board, it goes to stdout
+ * the uart is busy for cost_model::uart_byte_ns after it, check uart_ready first
+ */
+void uart_put(uint8_t byte);
+
+} // namespace host
+
+using std::endl;
+using std::dec;
+using std::hex;
+using std::setw;
+using std::setfill;
+
+} // namespace hwlib
+
+// ==========================================================================
+//
+// the Arduino Due pin classes, backed by the active board
+//
+// ==========================================================================
+
+namespace due {
+
+using pins = hwlib::host::pins;
+using ad_pins = hwlib::host::ad_pins;
+
+class pin_in : public hwlib::pin_in {
+private:
+    hwlib::host::digital_pin & pin;
+
+public:
+    pin_in(pins name);
+    bool read() override;
+    // an input that nothing drives reads what its pull up makes of it
+    void pullup_enable() { pin.level = true; }
+    void pullup_disable() { pin.level = false; }
+};
+
+class pin_out : public hwlib::pin_out {
+private:
+    hwlib::host::digital_pin & pin;
+
+public:
+    pin_out(pins name);
+    void write(bool x) override;
+};
+
+class pin_in_out : public hwlib::pin_in_out {
+private:
+    hwlib::host::digital_pin & pin;
+
+public:
+    pin_in_out(pins name);
+    void direction_set_input() override {}
+    bool read() override;
+    void direction_set_output() override {}
+    void write(bool x) override;
+    void pullup_enable() {}
+    void pullup_disable() {}
+};
+
+class pin_oc : public hwlib::pin_oc {
+private:
+    hwlib::host::digital_pin & pin;
+
+public:
+    pin_oc(pins name);
+    bool read() override;
+    void write(bool x) override;
+};
+
+class pin_adc : public hwlib::adc {
+private:
+    hwlib::host::analog_pin & pin;
+
+public:
+    pin_adc(ad_pins name);
+    adc_value_type read() override;
+};
+
+} // namespace due
+
+namespace hwlib {
+    namespace target = ::due;
+}
+
+#endif //RCCAR_HOST_HWLIB_HPP
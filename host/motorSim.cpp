@@ -0,0 +1,299 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+// Speed control simulator: the real speedControl, speed sensor and
+// staticIBT_2 on a simulated car drive a dcMotorPlant through a
+// virtualPCA9685. Every scenario steps the target from standstill to
+// --target and after 2 s down to half of it, and is run open loop (only the
+// feed-forward) and closed loop. Prints rise time, overshoot, settling time
+// and steady state error of the true speed for every scenario. A second run
+// reverses to minus half of --target after 2 s, and prints how long the motor
+// was driven against the wheels (plugged), braked and coasted, and how long it
+// took to reach 90% of the new speed.
+// The defaults are the pins, sensor and gains of mainCar.cpp.
+//
+// usage: motorsim [--kp n] [--ki n] [--kd n] [--kff n] [--kick n] [--ilimit n]
+//                 [--period ms] [--target counts_per_s] [--encoder] [--csv file]
+
+#include "hwlib.hpp"
+#include "virtualPCA9685.hpp"
+#include "dcMotorPlant.hpp"
+#include "PCA9685.hpp"
+#include "staticDrive.hpp"
+#include "speedSensor.hpp"
+#include "speedController.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+struct settings {
+    pidGains gains = { 10240, 512, 0, 3840, 100, 1024 };
+    uint32_t periodMs = 20;
+    int32_t target = 160;
+    bool encoder = false;           /**< quadrature encoder instead of the tachometer */
+    const char * csv = nullptr;     /**< trace of the nominal closed loop run */
+};
+
+struct scenario {
+    const char * name;
+    double batteryV;
+    double load;
+};
+
+const scenario scenarios[] = {
+    { "nominal",            7.4, 0      },
+    { "full battery",       8.4, 0      },
+    { "low battery",        6.6, 0      },
+    { "uphill",             7.4, 0.006  },
+    { "low battery uphill", 6.6, 0.006  },
+};
+
+struct sample {
+    double t;
+    int32_t target;
+    int32_t measured;
+    double actual;
+    int16_t output;
+    bool braking;               /**< both half bridges low and the enable on */
+};
+
+struct metrics {
+    double riseMs = NAN;        /**< 10% to 90% of the first step */
+    double overshoot = 0;       /**< percent above the target, first step */
+    double settleMs = NAN;      /**< from the step until the speed stays within 5% of the target */
+    double error = 0;           /**< percent, mean over the last 0.5 s of the first step */
+    double errorHalf = 0;       /**< same for the second step */
+};
+
+struct reversalMetrics {
+    double pluggedMs = 0;       /**< after the reversal, driven against the way the wheels turn */
+    double brakedMs = 0;        /**< after the reversal, braked */
+    double coastMs = 0;         /**< after the reversal, output 0 without the brake */
+    double reversedMs = NAN;    /**< from the reversal until 90% of the new speed */
+};
+
+const double STEP_S = 2.0;
+const double REVERSAL_S = 8.0;      /**< the car coasts to a stop before it reverses, that takes a while */
+
+void usage() {
+    std::fprintf(stderr,
+        "usage: motorsim [--kp n] [--ki n] [--kd n] [--kff n] [--kick n] [--ilimit n]\n"
+        "                [--period ms] [--target counts_per_s] [--encoder] [--csv file]\n");
+    std::exit(1);
+}
+
+settings parse(int argc, char * argv[]) {
+    settings s;
+    for (int i = 1; i < argc; i++) {
+        const char * option = argv[i];
+        if (!std::strcmp(option, "--encoder")) {
+            s.encoder = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage();
+        }
+        long value = std::strtol(argv[++i], nullptr, 0);
+        if (!std::strcmp(option, "--kp")) {
+            s.gains.kp = value;
+        } else if (!std::strcmp(option, "--ki")) {
+            s.gains.ki = value;
+        } else if (!std::strcmp(option, "--kd")) {
+            s.gains.kd = value;
+        } else if (!std::strcmp(option, "--kff")) {
+            s.gains.kff = value;
+        } else if (!std::strcmp(option, "--kick")) {
+            s.gains.kickstart = value;
+        } else if (!std::strcmp(option, "--ilimit")) {
+            s.gains.integralLimit = value;
+        } else if (!std::strcmp(option, "--period")) {
+            s.periodMs = value;
+        } else if (!std::strcmp(option, "--target")) {
+            s.target = value;
+        } else if (!std::strcmp(option, "--csv")) {
+            s.csv = argv[i];
+        } else {
+            usage();
+        }
+    }
+    if (s.periodMs < 1 || s.target < 1) {
+        usage();
+    }
+    return s;
+}
+
+template<typename SENSOR>
+std::vector<sample> drive(hwlib::host::board & car, const virtualPCA9685 & chip, dcMotorPlant & plant,
+                          SENSOR & sensor, const pidGains & gains, const settings & s, bool reverse) {
+    auto scl = due::pin_oc(due::pins::scl);
+    auto sda = due::pin_oc(due::pins::sda);
+    auto i2c_bus = hwlib::i2c_bus_bit_banged_scl_sda(scl, sda);
+    auto PCA = PCA9685_i2c(i2c_bus);
+    PCA.begin();
+    PCA.setOscillatorFrequency(27000000);
+    PCA.setPWMFreq(50);
+    hwlib::wait_ms(10);
+
+    // the pins of mainCar.cpp
+    staticIBT_2<1, 3, 2> motor(PCA);
+    speedControl<SENSOR, staticIBT_2<1, 3, 2>> control(sensor, motor, gains, s.periodMs * 1000);
+    control.setStopMode(stopMode::BRAKE);
+
+    std::vector<sample> trace;
+    uint_fast64_t start = car.now_ns();
+    uint_fast64_t end = start + (uint_fast64_t) ((STEP_S + (reverse ? REVERSAL_S : STEP_S)) * 1e9);
+    uint_fast64_t nextSample = start;
+    while (car.now_ns() < end) {
+        double t = (car.now_ns() - start) / 1e9;
+        int32_t wanted = t < STEP_S ? s.target : (reverse ? -s.target / 2 : s.target / 2);
+        control.setTarget(wanted);
+        control.loop();
+        if (car.now_ns() >= nextSample) {
+            plant.advanceTo(car.now_ns());
+            bool braking = chip.channel(1).ticks == 4096 && !chip.channel(3).ticks && !chip.channel(2).ticks;
+            trace.push_back(sample{ t, wanted, control.getMeasured(), plant.countsPerSecond(), control.getOutput(),
+                                    braking });
+            nextSample += 1000000;
+        }
+    }
+    return trace;
+}
+
+std::vector<sample> run(const scenario & sc, const pidGains & gains, const settings & s, bool reverse = false) {
+    hwlib::host::board car;
+    virtualPCA9685 chip(car, 0x40, 27000000);
+    car.attach(chip);
+    hwlib::host::board_scope scope(car);
+
+    dcMotorParameters parameters;
+    parameters.batteryV = sc.batteryV;
+    parameters.load = sc.load;
+    dcMotorPlant plant(car, chip, 1, 3, 2, parameters);
+
+    if (s.encoder) {
+        plant.attachEncoder(car.pin(hwlib::host::pins::d3), car.pin(hwlib::host::pins::d4));
+        auto a = due::pin_in(due::pins::d3);
+        auto b = due::pin_in(due::pins::d4);
+        quadratureEncoder sensor(a, b);
+        return drive(car, chip, plant, sensor, gains, s, reverse);
+    }
+    plant.attachTachometer(car.pin(hwlib::host::pins::d3));
+    auto input = due::pin_in(due::pins::d3);
+    tachometer sensor(input);
+    return drive(car, chip, plant, sensor, gains, s, reverse);
+}
+
+metrics measure(const std::vector<sample> & trace, int32_t target) {
+    metrics m;
+    double peak = 0, sum = 0, sumHalf = 0;
+    size_t n = 0, nHalf = 0;
+    double lastOutside = 0;
+    double t10 = NAN, t90 = NAN;
+    for (auto & x : trace) {
+        if (x.t < STEP_S) {
+            if (std::isnan(t10) && x.actual >= 0.1 * target) {
+                t10 = x.t;
+            }
+            if (std::isnan(t90) && x.actual >= 0.9 * target) {
+                t90 = x.t;
+            }
+            peak = x.actual > peak ? x.actual : peak;
+            if (std::fabs(x.actual - target) > 0.05 * target) {
+                lastOutside = x.t;
+            }
+            if (x.t >= STEP_S - 0.5) {
+                sum += x.actual;
+                n++;
+            }
+        } else if (x.t >= 2 * STEP_S - 0.5) {
+            sumHalf += x.actual;
+            nHalf++;
+        }
+    }
+    m.riseMs = (t90 - t10) * 1000;
+    m.overshoot = peak > target ? (peak - target) * 100.0 / target : 0;
+    m.settleMs = lastOutside < STEP_S - 0.5 ? lastOutside * 1000 : NAN;
+    m.error = n ? (sum / n - target) * 100.0 / target : 0;
+    m.errorHalf = nHalf ? (sumHalf / nHalf - target / 2.0) * 100.0 / (target / 2.0) : 0;
+    return m;
+}
+
+reversalMetrics measureReversal(const std::vector<sample> & trace, int32_t target) {
+    reversalMetrics m;
+    for (size_t n = 1; n < trace.size(); n++) {
+        auto & x = trace[n];
+        if (x.t < STEP_S) {
+            continue;
+        }
+        double ms = (x.t - trace[n - 1].t) * 1000;
+        if ((x.output > 0 && x.actual < 0) || (x.output < 0 && x.actual > 0)) {
+            m.pluggedMs += ms;
+        } else if (x.output == 0 && x.braking) {
+            m.brakedMs += ms;
+        } else if (x.output == 0) {
+            m.coastMs += ms;
+        }
+        if (std::isnan(m.reversedMs) && x.actual <= -0.9 * target / 2) {
+            m.reversedMs = (x.t - STEP_S) * 1000;
+        }
+    }
+    return m;
+}
+
+void print(const char * name, const char * loop, const metrics & m) {
+    std::printf("%-20s %-7s %9.0f %9.1f %9.0f %9.1f %9.1f\n", name, loop,
+                m.riseMs, m.overshoot, m.settleMs, m.error, m.errorHalf);
+}
+
+} // namespace
+
+int main(int argc, char * argv[]) {
+    settings s = parse(argc, argv);
+
+    // open loop is the same controller with only the feed-forward, like setVelocity(Y * 4) before
+    pidGains open = { 0, 0, 0, s.gains.kff, s.gains.kickstart, 0 };
+
+    std::printf("target %d counts/s, %s, update every %u ms\n", s.target,
+                s.encoder ? "quadrature encoder" : "tachometer", s.periodMs);
+    std::printf("gains kp %d ki %d kd %d kff %d kick %d integral limit %d (%d is 1.0)\n\n",
+                s.gains.kp, s.gains.ki, s.gains.kd, s.gains.kff, s.gains.kickstart, s.gains.integralLimit,
+                1 << PID_SHIFT);
+    std::printf("%-20s %-7s %9s %9s %9s %9s %9s\n", "scenario", "loop", "rise ms", "over %", "settle ms",
+                "error %", "half e %");
+    for (auto & sc : scenarios) {
+        print(sc.name, "open", measure(run(sc, open, s), s.target));
+        auto trace = run(sc, s.gains, s);
+        print(sc.name, "closed", measure(trace, s.target));
+        if (s.csv && &sc == &scenarios[0]) {
+            FILE * f = std::fopen(s.csv, "w");
+            if (!f) {
+                std::fprintf(stderr, "motorsim: cannot open %s\n", s.csv);
+                return 1;
+            }
+            std::fprintf(f, "t,target,measured,actual,output\n");
+            for (auto & x : trace) {
+                std::fprintf(f, "%.3f,%d,%d,%.1f,%d\n", x.t, x.target, x.measured, x.actual, x.output);
+            }
+            std::fclose(f);
+        }
+    }
+
+    std::printf("\nreversal to %d counts/s\n", -s.target / 2);
+    std::printf("%-20s %-7s %9s %9s %9s %9s\n", "scenario", "loop", "plug ms", "brake ms", "coast ms", "90% ms");
+    for (auto & sc : scenarios) {
+        reversalMetrics m = measureReversal(run(sc, s.gains, s, true), s.target);
+        std::printf("%-20s %-7s %9.0f %9.0f %9.0f %9.0f\n", sc.name, "closed",
+                    m.pluggedMs, m.brakedMs, m.coastMs, m.reversedMs);
+    }
+}
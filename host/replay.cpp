@@ -0,0 +1,236 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+// Replays edges recorded by a pulseCapture through the real Receiver433mhz
+// on a simulated car. Reads the serial log of a car built with RCCAR_CAPTURE
+// (other lines in the log are skipped) and prints every frame the receiver
+// accepts. Time is simulated, so a replay is deterministic and runs as fast
+// as the host allows; --repeat replays the capture several times and
+// reports the wall time per replay, to benchmark decoder changes.
+// The first capture keeps its own timestamps. Every edge is put just before
+// the clock read that timestamped it, and the receiver records the edges it
+// sees again, so its reads cost the same. A capture from channelsim then
+// replays exactly: channelsim writes how many frames it accepted, replay
+// checks that it accepts as many and exits with 1 when it does not.
+//
+// usage: replay [--address n] [--repeat n] [--quiet] file...
+
+#include "hwlib.hpp"
+#include "rfChannel.hpp"
+#include "Receiver433mhz.hpp"
+#include "pulseCapture.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct settings {
+    uint8_t address = 1;
+    unsigned long repeat = 1;
+    bool quiet = false;
+    std::vector<const char *> files;
+};
+
+void usage() {
+    std::fprintf(stderr, "usage: replay [--address n] [--repeat n] [--quiet] file...\n");
+    std::exit(1);
+}
+
+settings parse(int argc, char * argv[]) {
+    settings s;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--quiet")) {
+            s.quiet = true;
+        } else if (!std::strcmp(argv[i], "--address") && i + 1 < argc) {
+            s.address = std::strtoul(argv[++i], nullptr, 0);
+        } else if (!std::strcmp(argv[i], "--repeat") && i + 1 < argc) {
+            s.repeat = std::strtoul(argv[++i], nullptr, 0);
+        } else if (argv[i][0] == '-') {
+            usage();
+        } else {
+            s.files.push_back(argv[i]);
+        }
+    }
+    if (s.files.empty() || s.repeat < 1) {
+        usage();
+    }
+    return s;
+}
+
+/**
+ * \struct expectation. what the run that made the capture saw, from its capture-expect line
+ */
+struct expectation {
+    bool known = false;
+    unsigned long address = 0;      /**< address of the receiver that made the capture */
+    unsigned long accepted = 0;     /**< frames it accepted */
+    uint_fast64_t endNs = 0;        /**< time the receiver stopped */
+};
+
+/**
+ * \brief read the captures in a log and append them as pulses to one timeline
+ * the first capture keeps its timestamps, every next one starts 10ms after the end of the one
+ * before. the 31 bit timestamps are unwrapped. an edge timestamped t was read just before the
+ * clock read at t, so it goes clockReadNs before t
+ *
+ * @return number of edges read
+ */
+size_t load(const char * file, std::vector<pulse> & pulses, expectation & expect, uint_fast32_t clockReadNs) {
+    std::ifstream in(file);
+    if (!in) {
+        std::fprintf(stderr, "replay: cannot open %s\n", file);
+        std::exit(1);
+    }
+    size_t edges = 0;
+    uint_fast64_t offset = 0, previous = 0, start = 0, base = 0;
+    bool high = false, first = true;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream words(line);
+        std::string word;
+        words >> word;
+        if (word == "capture-begin") {
+            // the next capture goes after everything that is already on the timeline
+            base = pulses.empty() ? 0 : pulses.back().fall + 10000000;
+            high = false;
+            first = true;
+            continue;
+        }
+        if (word == "capture-expect") {
+            expect.known = (bool) (words >> expect.address >> expect.accepted >> expect.endNs);
+            continue;
+        }
+        int level;
+        uint_fast64_t us;
+        if (word != "edge" || !(words >> level >> us)) {
+            continue;
+        }
+        edges++;
+        if (first) {
+            offset = 0;
+            start = pulses.empty() ? 0 : us;
+            first = false;
+        } else if (us < previous) {
+            offset += 0x80000000u;
+        }
+        previous = us;
+        uint_fast64_t ns = base + (us + offset - start) * 1000;
+        ns = ns > clockReadNs ? ns - clockReadNs : 0;
+        if (level && !high) {
+            pulses.push_back(pulse{ns, 0});
+        } else if (!level && high) {
+            pulses.back().fall = ns;
+        }
+        high = level;
+    }
+    // a capture that ends while the input is high has an open pulse
+    if (high) {
+        pulses.back().fall = pulses.back().rise + 1000;
+    }
+    return edges;
+}
+
+struct result {
+    unsigned long drive = 0;
+    unsigned long aux = 0;
+    unsigned long repeats = 0;      /**< accepted frames that changed nothing */
+    uint_fast64_t virtualNs = 0;
+};
+
+result run(const std::vector<pulse> & pulses, size_t edges, const expectation & expect, const settings & s,
+           bool print) {
+    hwlib::host::board car;
+    rfChannel channel(channelImpairments{});
+    uint_fast64_t end = expect.known ? expect.endNs : (pulses.empty() ? 0 : pulses.back().fall + 5000000);
+    channel.feed(pulses, end);
+    channel.attach(car.pin(hwlib::host::pins::d2));
+
+    hwlib::host::board_scope scope(car);
+    auto receiverPin = due::pin_in(due::pins::d2);
+    Receiver433mhz receiver(receiverPin, s.address);
+    // recording the edges costs a clock read each, like in the run that made the capture
+    std::vector<uint32_t> buffer(edges + 1);
+    pulseCapture capture(buffer.data(), buffer.size());
+    receiver.setCapture(capture);
+
+    // an idle receiver does nothing but read its input, skip to shortly before the first edge.
+    // whole ms keep the reads in step with the original
+    if (!pulses.empty() && pulses.front().rise > 10000000) {
+        hwlib::wait_us((pulses.front().rise - 10000000) / 1000000 * 1000);
+    }
+
+    result r;
+    while (car.now_ns() < end) {
+        receiver.messageLoop();
+        if (!receiver.messageAvailable()) {
+            continue;
+        }
+        if (!receiver.getChanges()) {
+            r.repeats++;
+        }
+        if (receiver.isAux()) {
+            r.aux++;
+            if (print) {
+                std::printf("%12.3f ms  aux    field %2d value %4d  changes %02x\n", car.now_ns() / 1e6,
+                            receiver.getAuxIndex(), receiver.getAuxValue(), receiver.getChanges());
+            }
+        } else {
+            r.drive++;
+            if (print) {
+                std::printf("%12.3f ms  drive  motor %s Y %4d  servo %s X %3d  changes %02x\n", car.now_ns() / 1e6,
+                            receiver.getMotorDir() ? "fwd" : "bwd", receiver.getY(),
+                            receiver.getServoDir() ? "right" : "left ", receiver.getX(), receiver.getChanges());
+            }
+        }
+    }
+    r.virtualNs = car.now_ns();
+    return r;
+}
+
+} // namespace
+
+int main(int argc, char * argv[]) {
+    settings s = parse(argc, argv);
+
+    std::vector<pulse> pulses;
+    size_t edges = 0;
+    expectation expect;
+    uint_fast32_t clockReadNs = hwlib::host::cost_model().clock_read_ns;
+    for (auto file : s.files) {
+        edges += load(file, pulses, expect, clockReadNs);
+    }
+    // the expectation only holds for a single capture, replayed for the same address
+    expect.known = expect.known && s.files.size() == 1 && expect.address == s.address;
+
+    result r;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < s.repeat; i++) {
+        r = run(pulses, edges, expect, s, !s.quiet && i == 0);
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / s.repeat;
+
+    std::printf("edges              %zu, %zu pulses\n", edges, pulses.size());
+    std::printf("frames accepted    %lu drive, %lu aux for address %d, %lu changed nothing\n",
+                r.drive, r.aux, s.address, r.repeats);
+    std::printf("replay             %.3f s virtual time, %.6f s wall time per replay, %.0fx real time\n",
+                r.virtualNs / 1e9, wall, wall > 0 ? r.virtualNs / 1e9 / wall : 0.0);
+    if (expect.known) {
+        bool same = r.drive + r.aux == expect.accepted;
+        std::printf("check              %lu frames accepted when captured, %s\n", expect.accepted,
+                    same ? "the same" : "MISMATCH");
+        return same ? 0 : 1;
+    }
+}
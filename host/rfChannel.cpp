@@ -0,0 +1,143 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "rfChannel.hpp"
+
+#include <algorithm>
+
+void pulseRecorder::attach(hwlib::host::digital_pin & pin) {
+    pin.sink = [this](bool level, uint_fast64_t ns) {
+        if (level && !high) {
+            pulses.push_back(pulse{ns, 0});
+        } else if (!level && high) {
+            pulses.back().fall = ns;
+        }
+        high = level;
+    };
+}
+
+std::vector<pulse> pulseRecorder::take() {
+    std::vector<pulse> done;
+    if (high) {
+        // the last pulse is still going, keep it for the next call
+        pulse open = pulses.back();
+        pulses.pop_back();
+        done.swap(pulses);
+        pulses.push_back(open);
+    } else {
+        done.swap(pulses);
+    }
+    return done;
+}
+
+rfChannel::rfChannel(const channelImpairments & impairments):
+    impairments(impairments),
+    random(impairments.seed)
+{
+    nextBurst = exponential(impairments.burstRate);
+    nextNoise = exponential(impairments.noiseRate);
+}
+
+uint_fast64_t rfChannel::exponential(double ratePerSecond) {
+    if (ratePerSecond <= 0) {
+        return UINT64_MAX;
+    }
+    std::exponential_distribution<double> interval(ratePerSecond);
+    return interval(random) * 1e9;
+}
+
+bool rfChannel::inBurst(uint_fast64_t rise, uint_fast64_t fall) {
+    uint_fast64_t length = impairments.burstUs * 1000;
+    // move on to the first dropout that does not end before this pulse
+    while (nextBurst != UINT64_MAX && nextBurst + length <= rise) {
+        uint_fast64_t gap = exponential(impairments.burstRate);
+        nextBurst = (gap == UINT64_MAX) ? UINT64_MAX : nextBurst + length + gap;
+    }
+    return nextBurst != UINT64_MAX && rise < nextBurst + length && fall > nextBurst;
+}
+
+uint_fast64_t rfChannel::onGrid(uint_fast64_t ns) const {
+    if (!gridNs) {
+        return ns;
+    }
+    return ns + (gridNs - (ns + gridOffsetNs) % gridNs) % gridNs;
+}
+
+void rfChannel::setGrid(uint_fast32_t periodNs, uint_fast32_t offsetNs) {
+    gridNs = periodNs;
+    gridOffsetNs = offsetNs;
+}
+
+void rfChannel::feed(const std::vector<pulse> & transmitted, uint_fast64_t until) {
+    std::normal_distribution<double> jitter(0, impairments.jitterUs * 1000);
+    std::uniform_real_distribution<double> unit(0, 1);
+    std::vector<pulse> arriving;
+
+    for (auto & p : transmitted) {
+        int_fast64_t width = p.fall - p.rise;
+        // a short pulse of the protocol is 200us and a long one 400us, one bit always takes 600us
+        if (impairments.flipRate > 0 && unit(random) < impairments.flipRate && width < 600000) {
+            width = 600000 - width;
+            flipped++;
+        }
+        int_fast64_t rise = p.rise;
+        int_fast64_t fall = p.rise + width + (int_fast64_t) (impairments.stretchUs * 1000);
+        if (impairments.jitterUs > 0) {
+            rise += (int_fast64_t) jitter(random);
+            fall += (int_fast64_t) jitter(random);
+        }
+        // the part of the timeline before segmentEnd may already have been read
+        rise = std::max<int_fast64_t>(rise, segmentEnd);
+        fall = std::max<int_fast64_t>(fall, rise + 1000);
+        arriving.push_back(pulse{(uint_fast64_t) rise, (uint_fast64_t) fall});
+    }
+
+    std::uniform_real_distribution<double> noiseWidth(impairments.noiseMinUs * 1000, impairments.noiseMaxUs * 1000);
+    while (nextNoise < until) {
+        uint_fast64_t start = std::max(nextNoise, segmentEnd);
+        arriving.push_back(pulse{start, start + (uint_fast64_t) noiseWidth(random)});
+        stray++;
+        uint_fast64_t gap = exponential(impairments.noiseRate);
+        nextNoise = (gap == UINT64_MAX) ? UINT64_MAX : nextNoise + gap;
+    }
+
+    std::sort(arriving.begin(), arriving.end(), [](const pulse & a, const pulse & b) {
+        return a.rise < b.rise;
+    });
+
+    for (auto & p : arriving) {
+        if (inBurst(p.rise, p.fall)) {
+            dropped++;
+            continue;
+        }
+        p.rise = onGrid(p.rise);
+        p.fall = onGrid(p.fall);
+        // the receiver only sees a level, overlapping pulses merge into one
+        if (!received.empty() && p.rise <= received.back().fall) {
+            received.back().fall = std::max(received.back().fall, p.fall);
+        } else {
+            received.push_back(p);
+        }
+    }
+    segmentEnd = std::max(segmentEnd, until);
+}
+
+bool rfChannel::levelAt(uint_fast64_t ns) const {
+    // the first pulse that has not ended yet, the pulses do not overlap so their falls are sorted too
+    auto p = std::upper_bound(received.begin(), received.end(), ns, [](uint_fast64_t t, const pulse & q) {
+        return t < q.fall;
+    });
+    return p != received.end() && p->rise <= ns;
+}
+
+void rfChannel::attach(hwlib::host::digital_pin & pin) {
+    pin.source = [this](uint_fast64_t ns) {
+        return levelAt(ns);
+    };
+}
@@ -0,0 +1,130 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_RFCHANNEL_HPP
+#define RCCAR_RFCHANNEL_HPP
+
+#include "hwlib.hpp"
+
+#include <random>
+#include <vector>
+
+/**
+ * \struct pulse. one high period on the 433mhz link, times in virtual nanoseconds
+ */
+struct pulse {
+    uint_fast64_t rise;
+    uint_fast64_t fall;
+};
+
+/**
+ * \class pulseRecorder. records the pulses written to a transmitter pin
+ * attach it to the pin of the transmitting board before the transmitter is constructed or used
+ */
+class pulseRecorder {
+private:
+    std::vector<pulse> pulses;
+    bool high = false;
+
+public:
+    /**
+     * \brief start recording the writes to a pin
+     *
+     * @param pin simulated pin of the transmitting board
+     */
+    void attach(hwlib::host::digital_pin & pin);
+
+    /**
+     * \brief hand over all pulses that have completed since the last call
+     */
+    std::vector<pulse> take();
+};
+
+/**
+ * \struct channelImpairments. everything that can go wrong between the transmitter and the receiver
+ * all rates are per second of virtual time, all durations in microseconds
+ */
+struct channelImpairments {
+    double jitterUs     = 0;        /**< standard deviation of the timing error of every edge */
+    double stretchUs    = 0;        /**< constant amount added to every pulse, negative to shorten */
+    double flipRate     = 0;        /**< probability per pulse that a short pulse becomes long and vice versa */
+    double burstRate    = 0;        /**< average number of dropouts per second */
+    double burstUs      = 0;        /**< length of one dropout, nothing gets through */
+    double noiseRate    = 0;        /**< average number of stray pulses per second */
+    double noiseMinUs   = 50;       /**< shortest stray pulse */
+    double noiseMaxUs   = 500;      /**< longest stray pulse */
+    uint_fast64_t seed  = 1;        /**< seed of the random generator, runs are reproducible */
+};
+
+/**
+ * \class rfChannel. applies channelImpairments to the transmitted pulses and acts as the receiver pin
+ * pulses are fed in chronological segments; the receiver side may read up to the end of the last segment.
+ */
+class rfChannel {
+private:
+    channelImpairments impairments;
+    std::mt19937_64 random;
+
+    std::vector<pulse> received;            /**< pulses as they arrive at the receiver, sorted */
+    uint_fast64_t segmentEnd = 0;           /**< end of the part of the timeline that has been generated */
+    uint_fast64_t nextBurst = 0;            /**< start of the next dropout */
+    uint_fast64_t nextNoise = 0;            /**< time of the next stray pulse */
+    uint_fast32_t gridNs = 0;               /**< edges are moved onto this grid, 0 leaves them where they are */
+    uint_fast32_t gridOffsetNs = 0;         /**< an edge is on the grid when its time plus this is a multiple of gridNs */
+
+    uint_fast64_t exponential(double ratePerSecond);
+    bool inBurst(uint_fast64_t rise, uint_fast64_t fall);
+    uint_fast64_t onGrid(uint_fast64_t ns) const;
+
+public:
+    /**
+     * \brief Standard constructor
+     *
+     * @param impairments the impairments to apply
+     */
+    rfChannel(const channelImpairments & impairments);
+
+    /**
+     * \brief pass transmitted pulses through the channel
+     *
+     * @param transmitted pulses from a pulseRecorder, all before until
+     * @param until end of this segment of the timeline
+     */
+    void feed(const std::vector<pulse> & transmitted, uint_fast64_t until);
+
+    /**
+     * \brief move every edge that is fed from now on to the next point of a grid
+     * a pulseCapture keeps whole microseconds. with the edges on that grid, just before the clock
+     * read that timestamps them, a replay of the capture puts every edge between the same two reads
+     * of the receiver as the original, see host/replay
+     *
+     * @param periodNs distance between the points of the grid
+     * @param offsetNs a point of the grid plus offsetNs is a multiple of periodNs
+     */
+    void setGrid(uint_fast32_t periodNs, uint_fast32_t offsetNs);
+
+    /**
+     * \brief level at the receiver at a point in time, to be used as digital_pin::source
+     * several receivers, each on its own board and clock, may read the same channel
+     *
+     * @param ns virtual time in nanoseconds
+     */
+    bool levelAt(uint_fast64_t ns) const;
+
+    /**
+     * \brief connect the output of the channel to a pin of the receiving board
+     */
+    void attach(hwlib::host::digital_pin & pin);
+
+    uint_fast32_t flipped = 0;      /**< pulses changed from short to long or the other way around */
+    uint_fast32_t dropped = 0;      /**< pulses lost in a dropout */
+    uint_fast32_t stray = 0;        /**< stray pulses added */
+};
+
+#endif //RCCAR_RFCHANNEL_HPP
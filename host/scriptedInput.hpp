@@ -0,0 +1,131 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_SCRIPTEDINPUT_HPP
+#define RCCAR_SCRIPTEDINPUT_HPP
+
+#include "hwlib.hpp"
+#include "inputController.hpp"
+
+#include <algorithm>
+#include <istream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * \class scriptedInput. an input device that plays back a list of points, made by a script or recorded
+ * the axes move in straight lines between the points, two points at the same time make a step.
+ * the buttons are those of the last point that has passed. before the first point the input
+ * is at the first point, after the last one it stays at the last one. read() plays it on the
+ * clock of the active board.
+ */
+template<uint8_t N, uint8_t BUTTONS = 0>
+class scriptedInput final : public inputController<N, BUTTONS> {
+public:
+    using snapshot = inputSnapshot<N>;
+
+private:
+    std::vector<snapshot> points;
+
+public:
+    /**
+     * \brief add a point after the others
+     *
+     * @return false when the point is earlier than the last one, it is left out
+     */
+    bool add(const snapshot & point) {
+        if (!points.empty() && point.us < points.back().us) {
+            return false;
+        }
+        points.push_back(point);
+        return true;
+    }
+
+    /**
+     * \brief read points, one per line: time in ms, the axes as 12 bit values and optionally the buttons
+     * as a number, separated by spaces or commas. # starts a comment, lines without all axes are skipped
+     *
+     * @return the number of the first line that goes back in time, 0 when all went in
+     */
+    size_t load(std::istream & in) {
+        std::string line;
+        for (size_t number = 1; std::getline(in, line); number++) {
+            line = line.substr(0, line.find('#'));
+            std::replace(line.begin(), line.end(), ',', ' ');
+            std::istringstream fields(line);
+            double ms;
+            double axis[N];
+            if (!(fields >> ms)) {
+                continue;
+            }
+            bool complete = true;
+            for (uint8_t i = 0; i < N; i++) {
+                complete = complete && (fields >> axis[i]);
+            }
+            if (!complete) {
+                continue;
+            }
+            snapshot point;
+            point.us = ms * 1000;
+            for (uint8_t i = 0; i < N; i++) {
+                point.axis[i] = std::max(0.0, std::min(4095.0, axis[i] + 0.5));
+            }
+            if (!(fields >> point.buttons)) {
+                point.buttons = 0;
+            }
+            if (!add(point)) {
+                return number;
+            }
+        }
+        return 0;
+    }
+
+    bool empty() const {
+        return points.empty();
+    }
+
+    /**
+     * \brief time of the last point in us
+     */
+    uint_fast64_t duration() const {
+        return points.empty() ? 0 : points.back().us;
+    }
+
+    /**
+     * \brief the input at a moment, the script has to have a point
+     */
+    snapshot at(uint_fast64_t us) const {
+        auto next = std::upper_bound(points.begin(), points.end(), us, [](uint_fast64_t t, const snapshot & p) {
+            return t < p.us;
+        });
+        if (next == points.begin()) {
+            snapshot s = points.front();
+            s.us = us;
+            return s;
+        }
+        snapshot s = *(next - 1);
+        s.us = us;
+        if (next != points.end()) {
+            const snapshot & a = *(next - 1);
+            const snapshot & b = *next;
+            for (uint8_t i = 0; i < N; i++) {
+                s.axis[i] = a.axis[i] + ((int64_t) b.axis[i] - a.axis[i]) * (int64_t) (us - a.us)
+                                        / (int64_t) (b.us - a.us);
+            }
+        }
+        return s;
+    }
+
+    snapshot read() override {
+        return at(hwlib::now_us());
+    }
+};
+
+#endif //RCCAR_SCRIPTEDINPUT_HPP
@@ -0,0 +1,220 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+// Decodes the binary records of a telemetryStream (lib/telemetry.hpp) from
+// the serial log of a car or remote built with RCCAR_TELEMETRY. Text in the
+// log and damaged records are skipped. Prints every record, or a CSV with
+// --csv, and ends with a summary per record type: the count, the records
+// lost to a full buffer (gaps in the sequence) and the damaged records.
+// Reads standard input when no file is given, so the output of host/car or
+// host/remote can be piped in.
+//
+// usage: teledecode [--csv] [--summary] [file...]
+
+#include "telemetry.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+struct settings {
+    bool csv = false;
+    bool summary = false;       /**< only the summary, no records */
+    std::vector<const char *> files;
+};
+
+const char * const typeNames[] = { "loop", "rx_link", "tx_link", "motor", "steering", "stick", "wake" };
+static_assert(sizeof(typeNames) / sizeof(typeNames[0]) == (size_t) telemetryType::TYPES,
+              "every telemetry type needs a name");
+
+struct counts {
+    uint32_t records[(size_t) telemetryType::TYPES] = {};
+    uint32_t unknown = 0;       /**< records with a valid checksum and a type this decoder does not know */
+    uint32_t lost = 0;          /**< records missing from the sequence */
+    uint32_t damaged = 0;       /**< sync bytes that did not start a valid record */
+    uint32_t streams = 0;       /**< telemetry-begin lines, the board restarted */
+};
+
+void usage() {
+    std::fprintf(stderr, "usage: teledecode [--csv] [--summary] [file...]\n");
+    std::exit(1);
+}
+
+settings parse(int argc, char * argv[]) {
+    settings s;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--csv")) {
+            s.csv = true;
+        } else if (!std::strcmp(argv[i], "--summary")) {
+            s.summary = true;
+        } else if (argv[i][0] == '-' && argv[i][1]) {
+            usage();
+        } else {
+            s.files.push_back(argv[i]);
+        }
+    }
+    return s;
+}
+
+class decoder {
+private:
+    const settings & s;
+    counts & c;
+    std::vector<uint8_t> pending;
+    bool sequenceKnown = false;
+    uint8_t nextSequence = 0;
+
+    void print(const telemetryRecord & r) {
+        if (s.summary) {
+            return;
+        }
+        const char * name = r.type < telemetryType::TYPES ? typeNames[(size_t) r.type] : "?";
+        if (s.csv) {
+            std::printf("%u,%s,%u,%d,%d,%d\n", r.us, name, r.sequence, r.a, r.b, r.c);
+        } else {
+            std::printf("%10.3f ms %-8s #%-3u %6d %6d %6d\n", r.us / 1000.0, name, r.sequence, r.a, r.b, r.c);
+        }
+    }
+
+    void accept(const telemetryRecord & r) {
+        if (sequenceKnown) {
+            c.lost += (uint8_t) (r.sequence - nextSequence);
+        }
+        sequenceKnown = true;
+        nextSequence = r.sequence + 1;
+        if (r.type < telemetryType::TYPES) {
+            c.records[(size_t) r.type]++;
+        } else {
+            c.unknown++;
+        }
+        print(r);
+    }
+
+    static constexpr char BEGIN[] = "telemetry-begin";
+    static constexpr size_t BEGIN_LENGTH = sizeof(BEGIN) - 1;
+
+    /**
+     * \brief count the lines a stream starts with in a stretch of text, the sequence starts over after them
+     */
+    void findBegin(size_t from, size_t to) {
+        for (size_t i = from; i + BEGIN_LENGTH <= to; i++) {
+            if (!std::memcmp(&pending[i], BEGIN, BEGIN_LENGTH)) {
+                c.streams++;
+                sequenceKnown = false;
+            }
+        }
+    }
+
+public:
+    decoder(const settings & s, counts & c):
+        s(s),
+        c(c)
+    {}
+
+    /**
+     * \brief decode a piece of the log, a record may be cut over two pieces
+     */
+    void feed(const uint8_t * data, size_t size) {
+        pending.insert(pending.end(), data, data + size);
+        size_t i = 0;
+        while (i < pending.size()) {
+            if (pending[i] != telemetryWire::SYNC) {
+                size_t end = i;
+                while (end < pending.size() && pending[end] != telemetryWire::SYNC) {
+                    end++;
+                }
+                if (end == pending.size()) {
+                    // the text may go on in the next piece, keep the part that can still become a begin line
+                    size_t keep = end - i >= BEGIN_LENGTH ? end - BEGIN_LENGTH + 1 : i;
+                    findBegin(i, end);
+                    i = keep;
+                    break;
+                }
+                findBegin(i, end);
+                i = end;
+                continue;
+            }
+            if (pending.size() - i < telemetryWire::RECORD_BYTES) {
+                break;
+            }
+            const uint8_t * bytes = &pending[i];
+            if (telemetryWire::checksum(bytes) != bytes[telemetryWire::RECORD_BYTES - 1]) {
+                c.damaged++;
+                i++;
+                continue;
+            }
+            accept(telemetryRecord::fromBytes(bytes));
+            i += telemetryWire::RECORD_BYTES;
+        }
+        pending.erase(pending.begin(), pending.begin() + i);
+    }
+
+    /**
+     * \brief the end of the log, a record that is still cut is damaged
+     */
+    void finish() {
+        if (!pending.empty() && pending[0] == telemetryWire::SYNC) {
+            c.damaged++;
+        }
+        pending.clear();
+    }
+};
+
+void decode(FILE * in, decoder & d) {
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = std::fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        d.feed(buffer, n);
+    }
+    d.finish();
+}
+
+} // namespace
+
+int main(int argc, char * argv[]) {
+    settings s = parse(argc, argv);
+    counts c;
+    decoder d(s, c);
+
+    if (s.csv && !s.summary) {
+        std::printf("us,type,sequence,a,b,c\n");
+    }
+    if (s.files.empty()) {
+        decode(stdin, d);
+    }
+    for (auto file : s.files) {
+        FILE * in = std::fopen(file, "rb");
+        if (!in) {
+            std::fprintf(stderr, "teledecode: cannot open %s\n", file);
+            return 1;
+        }
+        decode(in, d);
+        std::fclose(in);
+    }
+
+    // with --csv the summary goes to stderr, so the output stays a clean table
+    FILE * out = s.csv && !s.summary ? stderr : stdout;
+    uint32_t total = c.unknown;
+    for (auto n : c.records) {
+        total += n;
+    }
+    std::fprintf(out, "%u records in %u streams, %u lost, %u damaged\n", total, c.streams, c.lost, c.damaged);
+    for (size_t i = 0; i < (size_t) telemetryType::TYPES; i++) {
+        if (c.records[i]) {
+            std::fprintf(out, "  %-8s %u\n", typeNames[i], c.records[i]);
+        }
+    }
+    if (c.unknown) {
+        std::fprintf(out, "  unknown  %u\n", c.unknown);
+    }
+    return 0;
+}
@@ -0,0 +1,63 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "vehicleModel.hpp"
+
+#include <cmath>
+
+vehicleModel::vehicleModel(const virtualPCA9685 & chip, dcMotorPlant & plant, uint8_t servoPin,
+                           const vehicleParameters & parameters):
+    chip(chip),
+    plant(plant),
+    servoPin(servoPin),
+    parameters(parameters)
+{}
+
+double vehicleModel::steeringFor(double pulse) const {
+    double angle = (parameters.centerUs - pulse) / parameters.lockUs * parameters.maxSteerRad;
+    return std::fmax(-parameters.maxSteerRad, std::fmin(parameters.maxSteerRad, angle));
+}
+
+double vehicleModel::speedFor(double countsPerSecond) const {
+    const dcMotorParameters & motor = plant.settings();
+    return countsPerSecond / motor.countsPerRev / parameters.axleRatio * 2 * M_PI * parameters.wheelRadius;
+}
+
+double vehicleModel::yawRate() const {
+    return speed * std::tan(steer) / parameters.wheelbase;
+}
+
+void vehicleModel::integrate(double seconds) {
+    // a servo without pulses holds where it is
+    if (pulseUs > 0) {
+        double wanted = steeringFor(pulseUs);
+        double most = parameters.servoRadPerS * seconds;
+        steer += std::fmax(-most, std::fmin(most, wanted - steer));
+    }
+    speed = speedFor(plant.countsPerSecond());
+    heading += yawRate() * seconds;
+    x += speed * std::cos(heading) * seconds;
+    y += speed * std::sin(heading) * seconds;
+}
+
+void vehicleModel::advanceTo(uint_fast64_t ns) {
+    auto & log = chip.changes();
+    while (now < ns) {
+        while (logIndex < log.size() && log[logIndex].ns <= now) {
+            if (log[logIndex].channel == servoPin) {
+                pulseUs = log[logIndex].value.ticks / 4096.0 / chip.frequencyHz() * 1e6;
+            }
+            logIndex++;
+        }
+        uint_fast64_t until = now + STEP_NS < ns ? now + STEP_NS : ns;
+        plant.advanceTo(until);
+        integrate((until - now) / 1e9);
+        now = until;
+    }
+}
@@ -0,0 +1,115 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_VEHICLEMODEL_HPP
+#define RCCAR_VEHICLEMODEL_HPP
+
+#include "hwlib.hpp"
+#include "virtualPCA9685.hpp"
+#include "dcMotorPlant.hpp"
+
+/**
+ * \struct vehicleParameters. the car around the motor and the steering servo
+ * the defaults are a 1:10 touring car, the servo turns the wheels to full lock at 500us from the center
+ */
+struct vehicleParameters {
+    double wheelbase    = 0.26;     /**< m between the axles */
+    double wheelRadius  = 0.032;    /**< m */
+    double axleRatio    = 2.6;      /**< turns of the sensor shaft per turn of the wheels */
+    double centerUs     = 1500;     /**< servo pulse that steers straight */
+    double lockUs       = 500;      /**< pulse from the center to full lock, a shorter pulse steers left */
+    double maxSteerRad  = 0.45;     /**< angle of the wheels at full lock */
+    double servoRadPerS = 5.0;      /**< fastest the servo turns the wheels */
+};
+
+/**
+ * \class vehicleModel. kinematic bicycle model of the car, driven by a dcMotorPlant and a servo on a virtualPCA9685
+ * the wheels roll without slip at the speed of the plant, the steering follows the servo pulse as fast as the
+ * servo can turn. follows the output log of the chip like the plant, so the order of the calls does not matter.
+ */
+class vehicleModel {
+private:
+    const virtualPCA9685 & chip;
+    dcMotorPlant & plant;
+    uint8_t servoPin;
+    vehicleParameters parameters;
+
+    size_t logIndex = 0;
+    uint_fast64_t now = 0;
+    double pulseUs = 0;         /**< servo pulse, 0 while there is none and the servo holds */
+    double steer = 0;           /**< angle of the wheels in rad, positive is left */
+    double speed = 0;           /**< m/s, positive is forward */
+    double x = 0, y = 0;        /**< position in m */
+    double heading = 0;         /**< rad, 0 is along x, positive is left */
+
+    void integrate(double seconds);
+
+public:
+    static constexpr uint32_t STEP_NS = 1000000;  /**< integration step */
+
+    /**
+     * \brief Standard constructor
+     *
+     * @param chip the PCA9685 the servo is connected to
+     * @param plant the motor that drives the wheels
+     * @param servoPin pin of the steering servo on the chip
+     * @param parameters see vehicleParameters
+     */
+    vehicleModel(const virtualPCA9685 & chip, dcMotorPlant & plant, uint8_t servoPin,
+                 const vehicleParameters & parameters = vehicleParameters());
+
+    /**
+     * \brief run the model, and the plant, up to a point in time
+     */
+    void advanceTo(uint_fast64_t ns);
+
+    /**
+     * \brief angle of the wheels for a servo pulse, once the servo got there
+     */
+    double steeringFor(double pulseUs) const;
+
+    /**
+     * \brief speed of the car in m/s for a speed of the sensor in counts per second
+     */
+    double speedFor(double countsPerSecond) const;
+
+    double steering() const {
+        return steer;
+    }
+
+    double velocity() const {
+        return speed;
+    }
+
+    /**
+     * \brief turn rate in rad/s
+     */
+    double yawRate() const;
+
+    double positionX() const {
+        return x;
+    }
+
+    double positionY() const {
+        return y;
+    }
+
+    double direction() const {
+        return heading;
+    }
+
+    /**
+     * \brief servo pulse seen last, in us
+     */
+    double servoPulse() const {
+        return pulseUs;
+    }
+};
+
+#endif //RCCAR_VEHICLEMODEL_HPP
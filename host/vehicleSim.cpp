@@ -0,0 +1,556 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+// Closed loop vehicle simulator: a scripted stick drives the remote, the
+// frames go over an rfChannel to the car, and the car drives a dcMotorPlant
+// and a steering servo on a virtualPCA9685 that move a vehicleModel. The
+// remote runs the stickSampler, remoteDrive and constructMessage of
+// mainRemote.cpp, the car the Receiver433mhz and carDrive of mainCar.cpp,
+// both with the configuration in lib/driveSetup.hpp. The lights go out in
+// aux frames like on the real remote, the response curves are those of
+// --profile. The remote idle mode is left out.
+//
+// Prints the frames that were sent and received and how far the steering
+// and the speed of the car lag behind the stick: the shift of the stick
+// signal that matches the car best, with the mean error left at that shift.
+// --csv writes stick, sent and received command, actuator outputs and
+// vehicle state every --csv-ms.
+//
+// The stick comes from --script (step, slalom) or a --trace file with one
+// point per line: time in ms, X and Y as 12 bit adc values, separated by
+// spaces or commas, # starts a comment. The stick moves in straight lines
+// between the points, two points at the same time make a step, see
+// scriptedInput.hpp. The script drives the adc under the joystick, with
+// --direct 1 the sampler reads the script itself, without the adc and the
+// noise.
+//
+// usage: vehiclesim [--script name | --trace file] [--direct 1] [--run ms] [--noise steps]
+//                   [--throttle-step n] [--throttle-step-us us] [--throttle-ramp-down 1]
+//                   [--steering-step n] [--steering-step-us us]
+//                   [--window-x n] [--window-y n] [--sample-us us]
+//                   [--look-ahead us] [--max-ahead us]
+//                   [--jitter us] [--flip p] [--seed n] [--profile n] [--csv file] [--csv-ms ms]
+
+#include "hwlib.hpp"
+#include "rfChannel.hpp"
+#include "virtualPCA9685.hpp"
+#include "dcMotorPlant.hpp"
+#include "vehicleModel.hpp"
+#include "joystick.hpp"
+#include "scriptedInput.hpp"
+#include "stickSampler.hpp"
+#include "remoteDrive.hpp"
+#include "Transmit433mhzController.hpp"
+#include "Receiver433mhz.hpp"
+#include "carDrive.hpp"
+#include "PCA9685.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using stickScript = scriptedInput<2>;
+
+struct settings {
+    stickScript stick;
+    const char * name = "step";
+    bool direct = false;                /**< the sampler reads the script instead of the adc */
+    double runMs = 0;                   /**< 0 runs until a second after the last point */
+    int noise = 0;                      /**< uniform noise on the adc, plus and minus this many steps */
+    rampSettings ramps = driveSetup::ramps;
+    uint16_t windowX = driveSetup::X_WINDOW, windowY = driveSetup::Y_WINDOW;
+    uint32_t sampleUs = driveSetup::SAMPLE_PERIOD_US;
+    predictorSettings prediction = driveSetup::commandPrediction;
+    uint8_t profile = 0;                /**< index in driveSetup::profiles */
+    channelImpairments channel;
+    const char * csv = nullptr;
+    uint32_t csvMs = 5;
+};
+
+void usage() {
+    std::fprintf(stderr,
+        "usage: vehiclesim [--script name | --trace file] [--direct 1] [--run ms] [--noise steps]\n"
+        "                  [--throttle-step n] [--throttle-step-us us] [--throttle-ramp-down 1]\n"
+        "                  [--steering-step n] [--steering-step-us us]\n"
+        "                  [--window-x n] [--window-y n] [--sample-us us]\n"
+        "                  [--look-ahead us] [--max-ahead us]\n"
+        "                  [--jitter us] [--flip p] [--seed n] [--profile n] [--csv file] [--csv-ms ms]\n"
+        "scripts: step, slalom\n");
+    std::exit(1);
+}
+
+stickScript::snapshot point(double ms, double x, double y) {
+    stickScript::snapshot p;
+    p.us = std::lround(ms * 1000);
+    p.axis[joystickController::X_AXIS] = std::lround(x);
+    p.axis[joystickController::Y_AXIS] = std::lround(y);
+    return p;
+}
+
+stickScript script(const char * name) {
+    stickScript stick;
+    if (!std::strcmp(name, "step")) {
+        // full throttle forward, then full steering, then let go
+        for (auto p : { point(0, 2048, 2048), point(500, 2048, 2048), point(500, 2048, 100),
+                        point(2500, 2048, 100), point(2500, 3995, 100), point(4500, 3995, 100),
+                        point(4500, 2048, 2048), point(6500, 2048, 2048) }) {
+            stick.add(p);
+        }
+        return stick;
+    }
+    if (!std::strcmp(name, "slalom")) {
+        // half throttle, weaving once every two seconds
+        stick.add(point(0, 2048, 2048));
+        stick.add(point(500, 2048, 2048));
+        stick.add(point(500, 2048, 1000));
+        for (double ms = 1000; ms <= 7000; ms += 20) {
+            stick.add(point(ms, 2048 + 1500 * std::sin(2 * M_PI * 0.5 * (ms - 1000) / 1000), 1000));
+        }
+        stick.add(point(7000, 2048, 2048));
+        stick.add(point(8000, 2048, 2048));
+        return stick;
+    }
+    usage();
+    return stick;
+}
+
+stickScript load(const char * file) {
+    std::ifstream in(file);
+    if (!in) {
+        std::fprintf(stderr, "vehiclesim: cannot open %s\n", file);
+        std::exit(1);
+    }
+    stickScript stick;
+    size_t line = stick.load(in);
+    if (line) {
+        std::fprintf(stderr, "vehiclesim: %s goes back in time at line %zu\n", file, line);
+        std::exit(1);
+    }
+    if (stick.empty()) {
+        std::fprintf(stderr, "vehiclesim: no points in %s\n", file);
+        std::exit(1);
+    }
+    return stick;
+}
+
+settings parse(int argc, char * argv[]) {
+    settings s;
+    for (int i = 1; i < argc; i++) {
+        const char * option = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+        }
+        const char * argument = argv[++i];
+        double value = std::strtod(argument, nullptr);
+        if (!std::strcmp(option, "--script")) {
+            s.name = argument;
+        } else if (!std::strcmp(option, "--trace")) {
+            s.name = argument;
+            s.stick = load(argument);
+        } else if (!std::strcmp(option, "--direct")) {
+            s.direct = value != 0;
+        } else if (!std::strcmp(option, "--run")) {
+            s.runMs = value;
+        } else if (!std::strcmp(option, "--noise")) {
+            s.noise = value;
+        } else if (!std::strcmp(option, "--throttle-step")) {
+            s.ramps.throttleStep = value;
+        } else if (!std::strcmp(option, "--throttle-step-us")) {
+            s.ramps.throttleStepUs = value;
+        } else if (!std::strcmp(option, "--throttle-ramp-down")) {
+            s.ramps.throttleRampDown = value != 0;
+        } else if (!std::strcmp(option, "--steering-step")) {
+            s.ramps.steeringStep = value;
+        } else if (!std::strcmp(option, "--steering-step-us")) {
+            s.ramps.steeringStepUs = value;
+        } else if (!std::strcmp(option, "--window-x")) {
+            s.windowX = value;
+        } else if (!std::strcmp(option, "--window-y")) {
+            s.windowY = value;
+        } else if (!std::strcmp(option, "--sample-us")) {
+            s.sampleUs = value;
+        } else if (!std::strcmp(option, "--look-ahead")) {
+            s.prediction.lookAheadUs = value;
+        } else if (!std::strcmp(option, "--max-ahead")) {
+            s.prediction.maxAheadUs = value;
+        } else if (!std::strcmp(option, "--jitter")) {
+            s.channel.jitterUs = value;
+        } else if (!std::strcmp(option, "--flip")) {
+            s.channel.flipRate = value;
+        } else if (!std::strcmp(option, "--seed")) {
+            s.channel.seed = value;
+        } else if (!std::strcmp(option, "--profile")) {
+            s.profile = value;
+        } else if (!std::strcmp(option, "--csv")) {
+            s.csv = argument;
+        } else if (!std::strcmp(option, "--csv-ms")) {
+            s.csvMs = value;
+        } else {
+            usage();
+        }
+    }
+    if (s.stick.empty()) {
+        s.stick = script(s.name);
+    }
+    if (s.runMs <= 0) {
+        s.runMs = s.stick.duration() / 1000.0 + 1000;
+    }
+    if (s.ramps.throttleStep < 1 || s.ramps.steeringStep < 1 || s.windowX < 1 || s.windowY < 1
+        || s.sampleUs < 1 || s.csvMs < 1 || s.profile >= driveSetup::PROFILES) {
+        usage();
+    }
+    return s;
+}
+
+/**
+ * \struct command. steering and throttle in the units of a frame, signed: X -511 to 511, Y -1023 to 1023
+ */
+struct command {
+    uint_fast64_t ns;
+    int32_t x, y;
+};
+
+/**
+ * \brief the last command before a moment, a zero command before the first
+ */
+command commandAt(const std::vector<command> & commands, uint_fast64_t ns) {
+    auto next = std::upper_bound(commands.begin(), commands.end(), ns, [](uint_fast64_t t, const command & c) {
+        return t < c.ns;
+    });
+    return next == commands.begin() ? command{ 0, 0, 0 } : *(next - 1);
+}
+
+/**
+ * \class remoteStick. the stick of the remote: the joystick on the adc, or the script itself
+ */
+class remoteStick final : public inputController<2, 1> {
+private:
+    joystickController & joy;
+    const stickScript & script;
+    bool direct;
+
+public:
+    remoteStick(joystickController & joy, const stickScript & script, bool direct):
+        joy(joy),
+        script(script),
+        direct(direct)
+    {}
+
+    snapshot read() override {
+        if (!direct) {
+            return joy.read();
+        }
+        auto s = script.at(hwlib::now_us());
+        snapshot stick;
+        stick.us = s.us;
+        stick.axis[joystickController::X_AXIS] = s.axis[joystickController::X_AXIS];
+        stick.axis[joystickController::Y_AXIS] = s.axis[joystickController::Y_AXIS];
+        return stick;
+    }
+};
+
+/**
+ * \class remoteSide. the remote and its joystick, on its own board
+ */
+class remoteSide {
+public:
+    hwlib::host::board board;
+    pulseRecorder recorder;
+    std::vector<command> sent;          /**< the drive values, every time a frame had one */
+    uint32_t frames = 0;                /**< drive and aux frames */
+
+private:
+    std::mt19937 random{1};
+    std::unique_ptr<due::pin_in> click;
+    std::unique_ptr<due::pin_adc> stickX, stickY;
+    std::unique_ptr<joystickController> joy;
+    std::unique_ptr<remoteStick> stick;
+    std::unique_ptr<stickSampler<remoteStick>> sampler;
+    std::unique_ptr<due::pin_out> transmitter;
+    std::unique_ptr<constructMessage> message;
+    std::unique_ptr<remoteDrive> drive;
+    command last = { 0, 0, 0 };
+
+public:
+    remoteSide(const settings & s) {
+        recorder.attach(board.pin(hwlib::host::pins::d9));
+        board.pin(hwlib::host::pins::d2).level = true;
+        auto adc = [this, &s](int value) -> uint_fast32_t {
+            if (s.noise) {
+                value += std::uniform_int_distribution<int>(-s.noise, s.noise)(random);
+            }
+            return value < 0 ? 0 : (value > 4095 ? 4095 : value);
+        };
+        board.adc(hwlib::host::ad_pins::a0).source = [adc, &s](uint_fast64_t ns) {
+            return adc(s.stick.at(ns / 1000).axis[joystickController::X_AXIS]);
+        };
+        board.adc(hwlib::host::ad_pins::a1).source = [adc, &s](uint_fast64_t ns) {
+            return adc(s.stick.at(ns / 1000).axis[joystickController::Y_AXIS]);
+        };
+
+        hwlib::host::board_scope scope(board);
+        click.reset(new due::pin_in(due::pins::d2));
+        stickX.reset(new due::pin_adc(due::ad_pins::a0));
+        stickY.reset(new due::pin_adc(due::ad_pins::a1));
+        joy.reset(new joystickController(*click, *stickX, *stickY));
+        stick.reset(new remoteStick(*joy, s.stick, s.direct));
+        sampler.reset(new stickSampler<remoteStick>(*stick, s.sampleUs, s.windowX, s.windowY));
+        transmitter.reset(new due::pin_out(due::pins::d9));
+        message.reset(new constructMessage(*transmitter, driveSetup::CAR_ADDRESS));
+        message->setBackground(*sampler);
+        drive.reset(new remoteDrive(*message, driveSetup::profiles[s.profile], s.ramps));
+    }
+
+    /**
+     * \brief one pass of the loop of mainRemote.cpp
+     */
+    void loop() {
+        hwlib::host::board_scope scope(board);
+        sampler->poll();
+        uint32_t frame = drive->update(sampler->getX(), sampler->getY(), hwlib::now_us());
+        if (frame & (1u << driveSetup::THROTTLE)) {
+            int32_t throttle = drive->throttle();
+            uint16_t y = constructMessage::adapter(std::min(throttle < 0 ? -throttle : throttle, 4095), 0, 4095, 0, 1023);
+            last.y = throttle >= 0 ? y : -y;
+        }
+        if (frame & (1u << driveSetup::STEERING)) {
+            int32_t steering = drive->steering();
+            uint16_t x = constructMessage::adapter(std::min(steering < 0 ? -steering : steering, 4095), 0, 4095, 0, 511);
+            last.x = steering >= 0 ? x : -x;
+        }
+        if (frame & ((1u << driveSetup::THROTTLE) | (1u << driveSetup::STEERING))) {
+            last.ns = board.now_ns();
+            sent.push_back(last);
+        }
+        if (frame) {
+            frames++;
+        }
+        message->makeMessage();
+    }
+};
+
+/**
+ * \struct sample. one line of the csv
+ */
+struct sample {
+    double ms;
+    stickScript::snapshot stick;
+    command sent, received;
+    double servoUs;
+    int16_t output;
+    int32_t target;
+    double speed, steer, yawRate, x, y, heading;
+};
+
+/**
+ * \class carSide. the car with its motor, servo and body, on its own board
+ */
+class carSide {
+public:
+    hwlib::host::board board;
+    virtualPCA9685 chip{ board, 0x40, 27000000 };
+    dcMotorPlant plant{ board, chip, 1, 3, 2 };
+    vehicleModel model{ chip, plant, 0 };
+    std::vector<command> received;
+
+private:
+    std::unique_ptr<due::pin_oc> scl, sda;
+    std::unique_ptr<hwlib::i2c_bus_bit_banged_scl_sda> bus;
+    std::unique_ptr<PCA9685_i2c> PCA;
+    std::unique_ptr<due::pin_in> tachoPin;
+    std::unique_ptr<due::pin_in> receiverPin;
+    std::unique_ptr<Receiver433mhz> receiver;
+    std::unique_ptr<carDrive> drive;
+
+public:
+    carSide(const settings & s, rfChannel & channel) {
+        board.attach(chip);
+        plant.attachTachometer(board.pin(hwlib::host::pins::d3));
+        channel.attach(board.pin(hwlib::host::pins::d2));
+
+        hwlib::host::board_scope scope(board);
+        receiverPin.reset(new due::pin_in(due::pins::d2));
+        receiver.reset(new Receiver433mhz(*receiverPin, driveSetup::CAR_ADDRESS));
+        scl.reset(new due::pin_oc(due::pins::scl));
+        sda.reset(new due::pin_oc(due::pins::sda));
+        bus.reset(new hwlib::i2c_bus_bit_banged_scl_sda(*scl, *sda));
+        PCA.reset(new PCA9685_i2c(*bus));
+        tachoPin.reset(new due::pin_in(due::pins::d3));
+        drive.reset(new carDrive(*receiver, *PCA, *tachoPin, s.prediction));
+        drive->begin();
+    }
+
+    /**
+     * \brief one pass of the loop of mainCar.cpp, without the profiler and the telemetry
+     */
+    void loop() {
+        hwlib::host::board_scope scope(board);
+        receiver->messageLoop();
+        if (receiver->messageAvailable() && !receiver->isAux()) {
+            int32_t x = receiver->getX() * (receiver->getServoDir() == 0 ? -1 : 1);
+            int32_t y = (receiver->getMotorDir() ? 1 : -1) * (int32_t) receiver->getY();
+            received.push_back(command{ board.now_ns(), x, y });
+        }
+        drive->receive();
+        drive->actuate();
+        drive->control();
+    }
+
+    int16_t output() const {
+        return drive->speedController().getOutput();
+    }
+
+    int32_t target() const {
+        return drive->speedController().getTarget();
+    }
+
+    const receiverStatistics & link() const {
+        return receiver->statistics();
+    }
+};
+
+/**
+ * \struct lag. how far a signal of the car is behind the same signal made straight from the stick
+ */
+struct lag {
+    double ms = 0;
+    double error = 0;       /**< mean absolute error at that shift */
+    double unshifted = 0;   /**< mean absolute error without a shift */
+};
+
+/**
+ * \brief find the shift of the ideal signal that matches the actual one best, up to 500ms
+ */
+template<typename IDEAL, typename ACTUAL>
+lag measureLag(const std::vector<sample> & samples, const stickScript & stick, uint32_t stepMs,
+               IDEAL ideal, ACTUAL actual) {
+    lag best;
+    best.error = INFINITY;
+    for (uint32_t shift = 0; shift <= 500; shift += stepMs) {
+        double sum = 0;
+        size_t n = 0;
+        for (auto & x : samples) {
+            if (x.ms < shift) {
+                continue;
+            }
+            sum += std::fabs(actual(x) - ideal(stick.at(std::lround((x.ms - shift) * 1000))));
+            n++;
+        }
+        double error = n ? sum / n : INFINITY;
+        if (shift == 0) {
+            best.unshifted = error;
+        }
+        if (error < best.error) {
+            best.error = error;
+            best.ms = shift;
+        }
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char * argv[]) {
+    settings s = parse(argc, argv);
+
+    rfChannel channel(s.channel);
+    remoteSide remote(s);
+    carSide car(s, channel);
+
+    std::vector<sample> samples;
+    uint_fast64_t end = (uint_fast64_t) (s.runMs * 1e6);
+    uint_fast64_t nextSample = 0;
+    while (remote.board.now_ns() < end) {
+        remote.loop();
+        uint_fast64_t until = remote.board.now_ns();
+        channel.feed(remote.recorder.take(), until);
+
+        // the car catches up with the air
+        while (car.board.now_ns() < until) {
+            car.loop();
+            if (car.board.now_ns() < nextSample) {
+                continue;
+            }
+            uint_fast64_t now = car.board.now_ns();
+            car.model.advanceTo(now);
+            const vehicleModel & m = car.model;
+            samples.push_back(sample{ now / 1e6, s.stick.at(now / 1000),
+                                      commandAt(remote.sent, now), commandAt(car.received, now),
+                                      m.servoPulse(), car.output(), car.target(),
+                                      m.velocity(), m.steering(), m.yawRate(), m.positionX(), m.positionY(),
+                                      m.direction() });
+            nextSample += (uint_fast64_t) s.csvMs * 1000000;
+        }
+    }
+
+    // the car without a remote in between: the stick through the curves straight to the servo pulse
+    // and the speed target. a stick below the center is forward
+    const curveProfile & curves = driveSetup::profiles[s.profile];
+    auto curved = [](const responseCurve & curve, int32_t value) {
+        value = std::max(-4095, std::min(4095, value));
+        return value < 0 ? -curve.apply(-value) : curve.apply(value);
+    };
+    auto idealSteering = [&car, &curves, curved](const stickScript::snapshot & p) {
+        int32_t rotation = curved(curves.steering, (p.axis[joystickController::X_AXIS] - 2048) * 2);
+        return car.model.steeringFor(driveSetup::steeringServo::mapInverse(rotation * 511 / 4095));
+    };
+    auto idealSpeed = [&car, &curves, curved](const stickScript::snapshot & p) {
+        int32_t throttle = curved(curves.throttle, (p.axis[joystickController::Y_AXIS] - 2048) * 2);
+        return car.model.speedFor(-throttle * driveSetup::MAX_SPEED / 4095.0);
+    };
+    lag steering = measureLag(samples, s.stick, s.csvMs, idealSteering, [](const sample & x) {
+        return x.steer;
+    });
+    lag speed = measureLag(samples, s.stick, s.csvMs, idealSpeed, [](const sample & x) {
+        return x.speed;
+    });
+
+    std::printf("stick %s%s, %.0f ms, noise %d, profile %u\n", s.name, s.direct ? " read directly" : "", s.runMs,
+                s.noise, s.profile);
+    std::printf("ramps throttle %u per %u us, steering %u per %u us, windows x %u y %u every %u us\n",
+                s.ramps.throttleStep, s.ramps.throttleStepUs, s.ramps.steeringStep, s.ramps.steeringStepUs,
+                s.windowX, s.windowY, s.sampleUs);
+    std::printf("car looks %d us ahead, at most %u us past a command\n",
+                s.prediction.lookAheadUs, s.prediction.maxAheadUs);
+    const receiverStatistics & link = car.link();
+    std::printf("frames             %lu sent, %lu received, %lu rejected, %lu damaged\n", (unsigned long) remote.frames,
+                (unsigned long) link.accepted, (unsigned long) link.rejected, (unsigned long) link.damaged);
+    std::printf("steering lag       %6.0f ms, error %.2f deg there, %.2f deg unshifted\n",
+                steering.ms, steering.error * 180 / M_PI, steering.unshifted * 180 / M_PI);
+    std::printf("speed lag          %6.0f ms, error %.3f m/s there, %.3f m/s unshifted\n",
+                speed.ms, speed.error, speed.unshifted);
+    std::printf("end                %.2f m, %.2f m, heading %.0f deg\n",
+                car.model.positionX(), car.model.positionY(), car.model.direction() * 180 / M_PI);
+
+    if (s.csv) {
+        FILE * f = std::fopen(s.csv, "w");
+        if (!f) {
+            std::fprintf(stderr, "vehiclesim: cannot open %s\n", s.csv);
+            return 1;
+        }
+        std::fprintf(f, "ms,stick_x,stick_y,sent_x,sent_y,received_x,received_y,servo_us,motor_output,"
+                        "speed_target,speed,steering_deg,yaw_rate_deg,x,y,heading_deg\n");
+        for (auto & x : samples) {
+            std::fprintf(f, "%.0f,%u,%u,%d,%d,%d,%d,%.0f,%d,%d,%.3f,%.2f,%.2f,%.3f,%.3f,%.1f\n",
+                         x.ms, x.stick.axis[joystickController::X_AXIS], x.stick.axis[joystickController::Y_AXIS], x.sent.x, x.sent.y, x.received.x, x.received.y,
+                         x.servoUs, x.output, x.target, x.speed, x.steer * 180 / M_PI, x.yawRate * 180 / M_PI,
+                         x.x, x.y, x.heading * 180 / M_PI);
+        }
+        std::fclose(f);
+    }
+}
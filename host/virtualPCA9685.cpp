@@ -0,0 +1,223 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "virtualPCA9685.hpp"
+
+virtualPCA9685::virtualPCA9685(hwlib::host::board & board, uint8_t address, double oscillatorHz):
+    board(board),
+    address(address),
+    oscillatorHz(oscillatorHz)
+{
+    powerOnReset();
+}
+
+void virtualPCA9685::powerOnReset() {
+    for (auto & r : registers) {
+        r = 0;
+    }
+    registers[MODE1] = MODE1_SLEEP | MODE1_ALLCALL;
+    registers[MODE2] = 0x04;
+    registers[0x02] = 0xE2;
+    registers[0x03] = 0xE4;
+    registers[0x04] = 0xE8;
+    registers[ALLCALLADR] = 0xE0;
+    for (int n = 0; n < 16; n++) {
+        registers[LED0_ON_L + 4 * n + 3] = FULL;
+    }
+    registers[PRESCALE] = 0x1E;
+    restartPending = false;
+    oscillatorReady = 0;
+    updateOutputs();
+}
+
+bool virtualPCA9685::acknowledges(uint_fast8_t a) const {
+    // the general call address is used for the software reset
+    generalCall = a == 0x00;
+    return a == address || a == 0x00
+        || ((registers[MODE1] & MODE1_ALLCALL) && a == (registers[ALLCALLADR] >> 1));
+}
+
+void virtualPCA9685::write_start() {
+    stats.writeTransactions++;
+    pointerPending = true;
+}
+
+void virtualPCA9685::write_byte(uint8_t b) {
+    stats.bytesWritten++;
+    if (pointerPending) {
+        pointerPending = false;
+        // a general call is recognised by its first byte, 0x06 is the software reset
+        if (b == 0x06 && generalCall) {
+            powerOnReset();
+            return;
+        }
+        pointer = b;
+        return;
+    }
+    writeRegister(pointer, b);
+    pointer = nextPointer(pointer);
+}
+
+void virtualPCA9685::read_start() {
+    stats.readTransactions++;
+    pointerPending = false;
+}
+
+uint8_t virtualPCA9685::read_byte() {
+    stats.bytesRead++;
+    uint8_t value = reg(pointer);
+    pointer = nextPointer(pointer);
+    return value;
+}
+
+void virtualPCA9685::stop() {
+    // with OCH cleared, which is the default, the outputs change on the stop condition
+    updateOutputs();
+}
+
+uint8_t virtualPCA9685::reg(uint8_t r) const {
+    if (r == MODE1) {
+        return registers[MODE1] | (restartPending ? MODE1_RESTART : 0);
+    }
+    if (r >= ALL_LED_ON_L && r <= ALL_LED_OFF_H) {
+        // the ALL_LED registers are write only
+        return 0;
+    }
+    return registers[r];
+}
+
+uint8_t virtualPCA9685::nextPointer(uint8_t r) const {
+    if (!(registers[MODE1] & MODE1_AI)) {
+        return r;
+    }
+    return r == LED15_OFF_H ? 0 : (uint8_t) (r + 1);
+}
+
+void virtualPCA9685::writeRegister(uint8_t r, uint8_t value) {
+    if (r == MODE1) {
+        bool wasSleeping = registers[MODE1] & MODE1_SLEEP;
+        bool sleeping = value & MODE1_SLEEP;
+        if (wasSleeping && !sleeping) {
+            oscillatorReady = board.now_ns() + 500000;
+        }
+        if (!wasSleeping && sleeping) {
+            // going to sleep with active outputs sets RESTART, see 7.3.1.1 of the datasheet
+            for (int n = 0; n < 16; n++) {
+                if (outputs[n].ticks) {
+                    restartPending = true;
+                }
+            }
+        }
+        if (value & MODE1_RESTART) {
+            restartPending = false;
+        }
+        registers[MODE1] = value & ~MODE1_RESTART;
+    } else if (r == PRESCALE) {
+        if (registers[MODE1] & MODE1_SLEEP) {
+            registers[PRESCALE] = value < 3 ? 3 : value;
+        } else {
+            stats.ignoredPrescaleWrites++;
+        }
+    } else if (r >= ALL_LED_ON_L && r <= ALL_LED_OFF_H) {
+        for (int n = 0; n < 16; n++) {
+            registers[LED0_ON_L + 4 * n + (r - ALL_LED_ON_L)] = value;
+        }
+        restartPending = false;
+    } else if (r >= LED0_ON_L && r <= LED15_OFF_H) {
+        registers[r] = value;
+        restartPending = false;
+    } else {
+        registers[r] = value;
+    }
+
+    // with OCH set the outputs change on the acknowledge of every byte
+    if (registers[MODE2] & MODE2_OCH) {
+        updateOutputs();
+    }
+}
+
+virtualPCA9685::output virtualPCA9685::programmed(uint8_t n) const {
+    const uint8_t * led = &registers[LED0_ON_L + 4 * n];
+    uint16_t on = led[0] | ((led[1] & 0x0F) << 8);
+    uint16_t off = led[2] | ((led[3] & 0x0F) << 8);
+    output o;
+    if (led[3] & FULL) {
+        // full off wins from full on
+        o = output{0, 0};
+    } else if (led[1] & FULL) {
+        o = output{0, 4096};
+    } else {
+        o = output{on, (uint16_t) ((off - on) & 0x0FFF)};
+    }
+    if (registers[MODE2] & MODE2_INVRT) {
+        o = output{(uint16_t) ((o.on + o.ticks) & 0x0FFF), (uint16_t) (4096 - o.ticks)};
+    }
+    return o;
+}
+
+bool virtualPCA9685::running() const {
+    return !(registers[MODE1] & MODE1_SLEEP) && !restartPending;
+}
+
+void virtualPCA9685::updateOutputs() {
+    // outputs that start after a wake up only start once the oscillator is stable
+    uint_fast64_t now = board.now_ns();
+    uint_fast64_t when = now > oscillatorReady ? now : oscillatorReady;
+    for (uint8_t n = 0; n < 16; n++) {
+        output value = running() ? programmed(n) : output{0, 0};
+        if (value != outputs[n]) {
+            outputs[n] = value;
+            log.push_back(change{ value.ticks ? when : now, n, value });
+            stats.outputChanges++;
+        }
+    }
+}
+
+double virtualPCA9685::frequencyHz() const {
+    return oscillatorHz / (4096.0 * (registers[PRESCALE] + 1));
+}
+
+virtualPCA9685::output virtualPCA9685::channel(uint8_t n) const {
+    return outputs[n & 0x0F];
+}
+
+double virtualPCA9685::dutyCycle(uint8_t n) const {
+    return channel(n).ticks / 4096.0;
+}
+
+double virtualPCA9685::pulseWidthUs(uint8_t n) const {
+    return dutyCycle(n) / frequencyHz() * 1e6;
+}
+
+uint8_t virtualPCA9685::peakSimultaneousOn(uint16_t channels) const {
+    // number of channels that switch on minus the number that switch off, per tick
+    int delta[4097] = {};
+    for (uint8_t n = 0; n < 16; n++) {
+        output o = outputs[n];
+        if (!(channels & (1u << n)) || !o.ticks) {
+            continue;
+        }
+        uint16_t end = o.on + o.ticks;
+        delta[o.on]++;
+        if (end > 4096) {
+            // the pulse wraps around, it is still high at the start of the period
+            delta[4096]--;
+            delta[0]++;
+            delta[end - 4096]--;
+        } else {
+            delta[end]--;
+        }
+    }
+    int high = 0, peak = 0;
+    for (int tick = 0; tick < 4096; tick++) {
+        high += delta[tick];
+        peak = high > peak ? high : peak;
+    }
+    return peak;
+}
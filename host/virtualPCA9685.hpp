@@ -0,0 +1,178 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_VIRTUALPCA9685_HPP
+#define RCCAR_VIRTUALPCA9685_HPP
+
+#include "hwlib.hpp"
+
+#include <vector>
+
+/**
+ * \class virtualPCA9685. register level model of a PCA9685 on the simulated i2c bus of a board
+ * modelled after the datasheet (rev. 4): MODE1 with SLEEP, RESTART, AI and ALLCALL, MODE2 with
+ * INVRT and OCH, PRESCALE that can only be written while sleeping, the LEDn and ALL_LED
+ * registers including the full on and full off bits, the 500us oscillator start-up after
+ * waking and the general call software reset.
+ * every change of an output is logged with the virtual time at which it happened.
+ */
+class virtualPCA9685 : public hwlib::host::i2c_device {
+public:
+    static constexpr uint8_t MODE1 = 0x00;
+    static constexpr uint8_t MODE2 = 0x01;
+    static constexpr uint8_t ALLCALLADR = 0x05;
+    static constexpr uint8_t LED0_ON_L = 0x06;
+    static constexpr uint8_t LED15_OFF_H = 0x45;
+    static constexpr uint8_t ALL_LED_ON_L = 0xFA;
+    static constexpr uint8_t ALL_LED_OFF_H = 0xFD;
+    static constexpr uint8_t PRESCALE = 0xFE;
+
+    static constexpr uint8_t MODE1_RESTART = 0x80;
+    static constexpr uint8_t MODE1_AI = 0x20;
+    static constexpr uint8_t MODE1_SLEEP = 0x10;
+    static constexpr uint8_t MODE1_ALLCALL = 0x01;
+    static constexpr uint8_t MODE2_INVRT = 0x10;
+    static constexpr uint8_t MODE2_OCH = 0x08;
+
+    static constexpr uint8_t FULL = 0x10;   /**< full on / full off bit in LEDn_ON_H / LEDn_OFF_H */
+
+    /**
+     * \struct output. the state of one channel as it is seen on the pin
+     */
+    struct output {
+        uint16_t on = 0;            /**< tick at which the pin goes high */
+        uint16_t ticks = 0;         /**< number of ticks the pin is high, 0 to 4096 */
+
+        bool operator==(const output & other) const {
+            return on == other.on && ticks == other.ticks;
+        }
+        bool operator!=(const output & other) const {
+            return !(*this == other);
+        }
+    };
+
+    /**
+     * \struct change. one entry in the output log
+     */
+    struct change {
+        uint_fast64_t ns;           /**< virtual time of the change */
+        uint8_t channel;            /**< channel 0 to 15 */
+        output value;               /**< new state of the channel */
+    };
+
+    /**
+     * \struct statistics. bus traffic addressed to this chip
+     */
+    struct statistics {
+        uint_fast32_t writeTransactions = 0;
+        uint_fast32_t readTransactions = 0;
+        uint_fast32_t bytesWritten = 0;     /**< including the register pointer */
+        uint_fast32_t bytesRead = 0;
+        uint_fast32_t outputChanges = 0;
+        uint_fast32_t ignoredPrescaleWrites = 0;    /**< writes to PRESCALE while awake, the chip blocks those */
+    };
+
+private:
+    hwlib::host::board & board;
+    uint8_t address;
+    double oscillatorHz;
+
+    uint8_t registers[256];
+    uint8_t pointer = 0;
+    bool pointerPending = false;
+    mutable bool generalCall = false;      /**< the current transaction is addressed to the general call address */
+    bool restartPending = false;            /**< the RESTART bit reads 1, outputs stay off until it is written */
+    uint_fast64_t oscillatorReady = 0;      /**< virtual time at which the oscillator is stable after waking */
+
+    output outputs[16];
+    std::vector<change> log;
+    statistics stats;
+
+    void powerOnReset();
+    void writeRegister(uint8_t reg, uint8_t value);
+    uint8_t nextPointer(uint8_t reg) const;
+    output programmed(uint8_t channel) const;
+    void updateOutputs();
+
+public:
+    /**
+     * \brief Standard constructor, the chip starts in its power-on state
+     *
+     * @param board board whose i2c bus the chip is connected to
+     * @param address 7 bit address as set by the address pads
+     * @param oscillatorHz frequency of the internal oscillator, nominally 25MHz
+     */
+    virtualPCA9685(hwlib::host::board & board, uint8_t address = 0x40, double oscillatorHz = 25000000);
+
+    bool acknowledges(uint_fast8_t address) const override;
+    void write_start() override;
+    void write_byte(uint8_t b) override;
+    void read_start() override;
+    uint8_t read_byte() override;
+    void stop() override;
+
+    /**
+     * \brief raw register content, as the chip would return it
+     */
+    uint8_t reg(uint8_t r) const;
+
+    /**
+     * \brief whether the outputs are running: awake and not waiting for a restart.
+     * changes right after waking are logged at the moment the oscillator is stable
+     */
+    bool running() const;
+
+    /**
+     * \brief PWM frequency that follows from PRESCALE and the oscillator
+     */
+    double frequencyHz() const;
+
+    /**
+     * \brief current state of a channel pin, all zero while the chip is not running
+     */
+    output channel(uint8_t n) const;
+
+    /**
+     * \brief fraction of the period a channel pin is high
+     */
+    double dutyCycle(uint8_t n) const;
+
+    /**
+     * \brief length of the high pulse of a channel pin in microseconds
+     */
+    double pulseWidthUs(uint8_t n) const;
+
+    /**
+     * \brief the most channels that are high at the same tick of the period, a measure for the peak current
+     *
+     * @param channels one bit per channel to take into account
+     */
+    uint8_t peakSimultaneousOn(uint16_t channels = 0xFFFF) const;
+
+    /**
+     * \brief all output changes since construction or the last clearLog()
+     */
+    const std::vector<change> & changes() const {
+        return log;
+    }
+
+    void clearLog() {
+        log.clear();
+    }
+
+    const statistics & traffic() const {
+        return stats;
+    }
+
+    void clearTraffic() {
+        stats = statistics();
+    }
+};
+
+#endif //RCCAR_VIRTUALPCA9685_HPP
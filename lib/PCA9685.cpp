@@ -31,12 +31,32 @@ void PCA9685_i2c::sleep() {
     uint8_t sleep = awake | bits.MODE1_SLEEP; // set sleep bit high
     writeByte(registers.MODE1, sleep);
     hwlib::wait_ms(5); // wait until cycle ends for sleep to be active
+    asleep = true;
 }
 
 void PCA9685_i2c::wakeup() {
     uint8_t sleep = readByte(registers.MODE1);
-    uint8_t wakeup = sleep & ~bits.MODE1_SLEEP; // set sleep bit low
+    uint8_t wakeup = sleep & ~(bits.MODE1_SLEEP | bits.MODE1_RESTART); // set sleep bit low
     writeByte(registers.MODE1, wakeup);
+    // the outputs run once the oscillator is stable
+    hwlib::wait_us(500);
+    if (sleep & bits.MODE1_RESTART) {
+        // the outputs were running before the sleep and nothing was written since, bring them back
+        writeByte(registers.MODE1, wakeup | bits.MODE1_RESTART);
+    }
+    asleep = false;
+}
+
+bool PCA9685_i2c::sleeping() const {
+    return asleep;
+}
+
+void PCA9685_i2c::wakeAfterWrite() {
+    wakeup();
+    uint32_t latency = hwlib::now_us() - wakeStart;
+    stats.wakes++;
+    stats.wakeLatencyUs = latency;
+    stats.wakeLatencyMaxUs = latency > stats.wakeLatencyMaxUs ? latency : stats.wakeLatencyMaxUs;
 }
 
 void PCA9685_i2c::setExtClk(uint8_t prescale) {
@@ -49,6 +69,7 @@ void PCA9685_i2c::setExtClk(uint8_t prescale) {
     writeByte(registers.MODE1, (newmode |= bits.MODE1_EXTCLK));
 
     writeByte(registers.PRESCALE, prescale); // set the prescaler
+    this->prescale = prescale;
 
     hwlib::wait_ms(5);
     // clear the SLEEP bit to start
@@ -73,6 +94,7 @@ void PCA9685_i2c::setPWMFreq(float freq) {
     uint8_t newmode = (oldmode & ~bits.MODE1_RESTART) | bits.MODE1_SLEEP; // sleep
     writeByte(registers.MODE1, newmode);                             // go to sleep
     writeByte(registers.PRESCALE, prescale); // set the prescaler
+    this->prescale = prescale;
     writeByte(registers.MODE1, oldmode);
     hwlib::wait_ms(5);
     // This sets the MODE1 register to turn on auto increment.
@@ -88,57 +110,85 @@ uint8_t PCA9685_i2c::getPWM(uint8_t num) {
     return readByte(registers.LED0_ON_L + 4 * num);
 }
 
-void PCA9685_i2c::setPWM(uint8_t num, uint16_t on, uint16_t off) {
-    uint8_t data [4] = { (uint8_t) on, (uint8_t) (on >> 8), (uint8_t) off, (uint8_t) (off >> 8) };
-    auto i2c = bus.write( address );
-    i2c.write( registers.LED0_ON_L + 4 * num );
-    i2c.write( data, 4 );
-}
-
-void PCA9685_i2c::setPin(uint8_t num, uint16_t val, bool invert) {
-    // value between 0 and 4095 explicitly.
-    val = (val > (uint16_t) 4095 ? (uint16_t) 4095 : val);
-    if (invert) {
-        if (val == 0) {
-            // Special value for signal fully on.
-            setPWM(num, 4096, 0);
-        } else if (val == 4095) {
-            // Special value for signal fully off.
-            setPWM(num, 0, 4096);
-        } else {
-            setPWM(num, 0, 4095 - val);
-        }
-    } else {
-        if (val == 4095) {
-            // Special value for signal fully on.
-            setPWM(num, 4096, 0);
-        } else if (val == 0) {
-            // Special value for signal fully off.
-            setPWM(num, 0, 4096);
-        } else {
-            setPWM(num, 0, val);
+void PCA9685_i2c::beginBatch() {
+    batching = true;
+}
+
+void PCA9685_i2c::endBatch() {
+    batching = false;
+    if (!staged) {
+        return;
+    }
+    uint8_t first = __builtin_ctz(staged);
+    uint8_t last = 31 - __builtin_clz(staged);
+    // the pins in between are rewritten with their shadow, from now on the chip has that too
+    known |= (0xFFFFu >> (15 - last)) & (0xFFFFu << first);
+    if (asleep) {
+        wakeStart = hwlib::now_us();
+    }
+    stats.transactions++;
+    stats.bytes += 2 + 4 * (last - first + 1);
+    {
+        // the chip increments the register pointer itself, MODE1_AI is set by setPWMFreq and setExtClk
+        auto i2c = bus.write( address );
+        i2c.write( registers.LED0_ON_L + 4 * first );
+        for (uint8_t num = first; num <= last; num++) {
+            uint8_t data [4] = { (uint8_t) shadowOn[num], (uint8_t) (shadowOn[num] >> 8),
+                                 (uint8_t) shadowOff[num], (uint8_t) (shadowOff[num] >> 8) };
+            i2c.write( data, 4 );
         }
     }
+    staged = 0;
+    if (asleep) {
+        wakeAfterWrite();
+    }
+}
+
+bool PCA9685_i2c::inBatch() const {
+    return batching;
 }
 
 void PCA9685_i2c::writeMicroseconds(uint8_t num, uint16_t Microseconds) {
+    // Read prescale, unless it is known from setPWMFreq or setExtClk
+    uint32_t prescale = this->prescale ? this->prescale : readPrescale();
+
+    // Equation 1 from the datasheet section 7.3.5, in integers: the Due has no FPU
+    // ticks = us / (1000000 * (prescale + 1) / oscillator_freq)
+    uint64_t ticks = (uint64_t) Microseconds * oscillator_freq / (1000000u * (prescale + 1));
+
+    num &= 0x0F;
+    if (ticks > 4095) {
+        // a pulse longer than the period is a pin that is always on
+        setPWM(num, 4096, 0);
+    } else {
+        setPWM(num, phase[num], (phase[num] + ticks) & 0x0FFF);
+    }
+}
 
-    double pulse = Microseconds;
-    double pulselength;
-    pulselength = 1000000; // 1,000,000 us per second
+void PCA9685_i2c::setPhase(uint8_t num, uint16_t on) {
+    phase[num & 0x0F] = on & 0x0FFF;
+}
 
-    // Read prescale
-    uint16_t prescale = readPrescale();
+void PCA9685_i2c::staggerPhases(uint16_t pins) {
+    uint8_t count = __builtin_popcount(pins);
+    uint8_t i = 0;
+    for (uint8_t num = 0; num < 16; num++) {
+        if (pins & (1u << num)) {
+            phase[num] = 4096u * i++ / count;
+        }
+    }
+}
 
-    // Calculate the pulse for PWM based on Equation 1 from the datasheet section
-    // 7.3.5
-    prescale += 1;
-    pulselength *= prescale;
-    pulselength /= oscillator_freq;
+uint16_t PCA9685_i2c::getPhase(uint8_t num) const {
+    return phase[num & 0x0F];
+}
 
-    pulse /= pulselength;
+void PCA9685_i2c::setDeadband(uint8_t num, uint8_t ticks) {
+    deadband[num & 0x0F] = ticks;
+}
 
-    setPWM(num, 0, pulse);
+const pca9685Statistics & PCA9685_i2c::statistics() const {
+    return stats;
 }
 
 uint32_t PCA9685_i2c::getOscillatorFrequency() const {
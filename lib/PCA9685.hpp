@@ -2,6 +2,7 @@
 #define RCCAR_PCA9685_HPP
 
 #include <hwlib.hpp>
+#include "latencyTrace.hpp"
 
 /**
  * \struct Registers. this struct exists of all the registers the PCA9685 needs for all of it's functions
@@ -111,6 +112,19 @@ struct pca9685Bits {
 };
 
 
+/**
+ * \struct pca9685Statistics. what the pin writes of a PCA9685_i2c cost on the bus
+ */
+struct pca9685Statistics {
+    uint32_t pinWrites = 0;         /**< setPWM calls, also through setPin and writeMicroseconds */
+    uint32_t suppressed = 0;        /**< pin writes that were dropped because the pin would not change */
+    uint32_t transactions = 0;      /**< LED register transactions that went out */
+    uint32_t bytes = 0;             /**< bytes of those transactions, including the address and the register */
+    uint32_t wakes = 0;             /**< times a pin write woke the chip from sleep() */
+    uint32_t wakeLatencyUs = 0;     /**< last wake: from the pin write that woke the chip until the outputs run with its value */
+    uint32_t wakeLatencyMaxUs = 0;  /**< longest of those */
+};
+
 // ==========================================================================
 //
 // PCA9685, accessed by i2c
@@ -133,6 +147,25 @@ protected:
 
     uint8_t PRESCALE_MIN = 3;   /**< minimum prescale value */
     uint8_t PRESCALE_MAX = 255; /**< maximum prescale value */
+    uint8_t prescale = 0;       /**< last prescale value written, 0 when unknown and it has to be read */
+
+    uint16_t shadowOn[16];      /**< on value last written to, or staged for, every pin */
+    uint16_t shadowOff[16];     /**< off value last written to, or staged for, every pin */
+    uint16_t staged = 0;        /**< pins with a value that has not been written yet, one bit per pin */
+    bool batching = false;      /**< setPWM only stages, see beginBatch() */
+    uint16_t phase[16];         /**< tick at which setPin and writeMicroseconds switch every pin on */
+    uint16_t known = 0;         /**< pins that have been written since construction, their shadow is what the chip has */
+    uint8_t deadband[16];       /**< smallest change of the pulse length in ticks that is written */
+    bool asleep = false;        /**< put to sleep by sleep(), the next transaction to the LED registers wakes it */
+    uint_fast64_t wakeStart = 0;    /**< when the transaction that wakes the chip started */
+    pca9685Statistics stats;
+
+    /**
+     * \brief wake the chip after a transaction to the LED registers went out while it slept.
+     * the registers already hold the new values, so the outputs restart with them and not with
+     * the values of before the sleep
+     */
+    void wakeAfterWrite();
 
     /**
      * \brief protected function to stop unauthorised reads from happening
@@ -159,13 +192,20 @@ public:
      * the constructor also creates the registers and bits structs with it's default values
      * the oscillator frequency is set to a default value because it cannot stay empty
      */
-    constexpr PCA9685_i2c( hwlib::i2c_bus & bus, uint_fast8_t address = 0x40):
+    PCA9685_i2c( hwlib::i2c_bus & bus, uint_fast8_t address = 0x40):
             bus( bus ),
             address( address ),
             registers( pca9685Registers() ),
             bits( pca9685Bits() ),
             oscillator_freq( 25000000 )
     {
+        // the pins start fully off
+        for (uint8_t i = 0; i < 16; i++) {
+            shadowOn[i] = 0;
+            shadowOff[i] = 4096;
+            phase[i] = 0;
+            deadband[i] = 0;
+        }
         // wait for the controller to be ready for the initialization
         hwlib::wait_ms( 20 );
     }
@@ -183,14 +223,24 @@ public:
 
     /**
      * \brief  Puts board into sleep mode
+     * the oscillator stops and all outputs are off, the LED registers keep their values.
+     * the next pin write that reaches the bus is written to the sleeping board and then wakes it, see wakeup()
      */
     void sleep();
 
     /**
      * \brief  Wakes board from sleep
+     * waits the 500us the oscillator needs to start. when the outputs were running before sleep() and
+     * no LED register was written since, the chip has set RESTART and the outputs are restarted with
+     * the values in the LED registers, as in 7.3.1.1 of the datasheet
      */
     void wakeup();
 
+    /**
+     * \brief whether the board was put to sleep and not woken since
+     */
+    bool sleeping() const;
+
     /**
      * \brief  Sets EXTCLK pin to use the external clock
      * @param  prescale Configures the prescale value to be used by the external clock
@@ -224,9 +274,65 @@ public:
      */
     void setPWM(uint8_t num, uint16_t on, uint16_t off);
 
+    /**
+     * \brief from now on setPWM, setPin and writeMicroseconds only stage their values
+     * the staged values are written by endBatch() in a single auto increment transaction,
+     * from the lowest to the highest staged pin, so all pins change at the same stop condition.
+     * pins in between that were not staged are rewritten with their current value.
+     * calling it while a batch is open does nothing, the batch simply grows
+     */
+    void beginBatch();
+
+    /**
+     * \brief write everything staged since beginBatch() in one transaction and stop batching
+     */
+    void endBatch();
+
+    /**
+     * \brief whether a batch is open
+     */
+    bool inBatch() const;
+
+    /**
+     * \brief set the tick in the period at which setPin and writeMicroseconds switch a pin on
+     * the pulse wraps around the end of the period when it does not fit after the phase.
+     * takes effect at the next setPin or writeMicroseconds of the pin
+     * @param  num Pin of the PCA9685, from 0 to 15
+     * @param  on tick from 0 to 4095
+     */
+    void setPhase(uint8_t num, uint16_t on);
+
+    /**
+     * \brief spread the on moments of a set of pins evenly over the period
+     * by default every pin switches on at tick 0, so the currents of all loads start together.
+     * with the pins staggered the peak current is lower and the rising edges are apart.
+     * @param  pins one bit per pin, the lowest pin starts at tick 0
+     */
+    void staggerPhases(uint16_t pins);
+
+    /**
+     * \brief tick at which a pin is switched on, see setPhase
+     */
+    uint16_t getPhase(uint8_t num) const;
+
+    /**
+     * \brief hysteresis for a pin: a new pulse that differs by at most this many ticks from
+     * the pulse on the pin is not written. switching fully on or off is always written.
+     * a write that would not change the pin at all is always dropped, also without a deadband.
+     * at 50Hz a tick is about 4.9us, so a few ticks hide the noise of the sticks from a servo
+     * @param  num Pin of the PCA9685, from 0 to 15
+     * @param  ticks 0 to 255, 0 drops only writes that change nothing
+     */
+    void setDeadband(uint8_t num, uint8_t ticks);
+
+    /**
+     * \brief counters of the pin writes, see pca9685Statistics
+     */
+    const pca9685Statistics & statistics() const;
+
     /**
      * \brief function that allows the PWM of a pin to be set without needing to set
-     * the 0 timing. It also can be used to invert the output.
+     * the on timing, it follows the phase of the pin. It also can be used to invert the output.
      * @param  num Pin of the PCA9685, from 0 to 15
      * @param  val number of ticks out of 4096 to be active.
      * should be a value from 0 to 4095.
@@ -256,6 +362,76 @@ public:
 };
 
 
+
+// setPWM and setPin are on the path from every command to the registers, they are inline so
+// compile time pin numbers and values fold into them
+inline void PCA9685_i2c::setPWM(uint8_t num, uint16_t on, uint16_t off) {
+    RCCAR_TRACE_POINT(tracePoint::PCA_WRITE, (num << 12) | (off & 0x0FFF));
+    num &= 0x0F;
+    stats.pinWrites++;
+    // the shadow is only trusted for pins that have been written, the chip may still run the
+    // values of before a reset of the Due
+    if (known & (1u << num) && on == shadowOn[num]) {
+        bool same = off == shadowOff[num];
+        if (!same && deadband[num] && on < 4096 && off < 4096 && shadowOff[num] < 4096) {
+            // difference of the pulse lengths, the off times may wrap around the period
+            int16_t delta = (int16_t) (((off - shadowOff[num]) & 0x0FFF) << 4) >> 4;
+            same = (delta < 0 ? -delta : delta) <= deadband[num];
+        }
+        if (same) {
+            stats.suppressed++;
+            return;
+        }
+    }
+    known |= 1u << num;
+    shadowOn[num] = on;
+    shadowOff[num] = off;
+    if (batching) {
+        staged |= 1u << num;
+        return;
+    }
+    if (asleep) {
+        wakeStart = hwlib::now_us();
+    }
+    uint8_t data [4] = { (uint8_t) on, (uint8_t) (on >> 8), (uint8_t) off, (uint8_t) (off >> 8) };
+    stats.transactions++;
+    stats.bytes += 6;
+    {
+        auto i2c = bus.write( address );
+        i2c.write( registers.LED0_ON_L + 4 * num );
+        i2c.write( data, 4 );
+    }
+    if (asleep) {
+        wakeAfterWrite();
+    }
+}
+
+inline void PCA9685_i2c::setPin(uint8_t num, uint16_t val, bool invert) {
+    // value between 0 and 4095 explicitly.
+    val = (val > (uint16_t) 4095 ? (uint16_t) 4095 : val);
+    if (invert) {
+        if (val == 0) {
+            // Special value for signal fully on.
+            setPWM(num, 4096, 0);
+        } else if (val == 4095) {
+            // Special value for signal fully off.
+            setPWM(num, 0, 4096);
+        } else {
+            setPWM(num, phase[num], (phase[num] + 4095 - val) & 0x0FFF);
+        }
+    } else {
+        if (val == 4095) {
+            // Special value for signal fully on.
+            setPWM(num, 4096, 0);
+        } else if (val == 0) {
+            // Special value for signal fully off.
+            setPWM(num, 0, 4096);
+        } else {
+            setPWM(num, phase[num], (phase[num] + val) & 0x0FFF);
+        }
+    }
+}
+
 /**
  * \class this class describes an hobby servo and makes it work with the PCA9685 library
  */
@@ -10,11 +10,25 @@
 #include "Receiver433mhz.hpp"
 
 
-Receiver433mhz::Receiver433mhz(hwlib::pin_in &input) :
-    input(input)
+Receiver433mhz::Receiver433mhz(hwlib::pin_in &input, uint8_t address) :
+    input(input),
+    address(address)
 {}
 
 
+void Receiver433mhz::setCapture(pulseCapture & c) {
+    capture = &c;
+}
+
+bool Receiver433mhz::readInput() {
+    bool level = input.read();
+    if (capture && level != inputLevel) {
+        capture->edge(level, hwlib::now_us());
+    }
+    inputLevel = level;
+    return level;
+}
+
 void Receiver433mhz::setReceiverLowFlag(bool b) {
     ReceiverLowFlag = b;
 }
@@ -39,25 +53,82 @@ uint16_t Receiver433mhz::getX(){
     return Xval;
 }
 
+bool Receiver433mhz::isAux(){
+    return auxFrame;
+}
+
+uint8_t Receiver433mhz::getAuxIndex(){
+    return auxIndex;
+}
+
+uint16_t Receiver433mhz::getAuxValue(){
+    return auxValue;
+}
+
 bool Receiver433mhz::messageAvailable(){
     return validMessage;
 }
 
+uint32_t Receiver433mhz::getCommand(){
+    return command;
+}
+
+uint8_t Receiver433mhz::getChanges(){
+    return changes;
+}
+
+bool Receiver433mhz::quiet() const {
+    return state == state_t::IDLE && !ReceiverLowFlag;
+}
+
+const receiverStatistics & Receiver433mhz::statistics() const {
+    return stats;
+}
+
+void Receiver433mhz::updateChanges(){
+    if (auxFrame) {
+        uint16_t field = 1u << auxIndex;
+        changes = !(auxKnown & field) || auxValues[auxIndex] != auxValue ? CHANGED_AUX : 0;
+        auxValues[auxIndex] = auxValue;
+        auxKnown |= field;
+        return;
+    }
+    // pack(~0) is the mask of a field in its place
+    using drive = linkFrames::driveFrame;
+    uint32_t next = frame & ~drive::pack<linkFrames::checksum>(~0u);
+    uint32_t difference = commandKnown ? next ^ command : ~0u;
+    changes = ((difference & drive::pack<linkFrames::motorDir>(~0u)) ? CHANGED_MOTOR_DIR : 0)
+            | ((difference & drive::pack<linkFrames::y>(~0u)) ? CHANGED_Y : 0)
+            | ((difference & drive::pack<linkFrames::servoDir>(~0u)) ? CHANGED_SERVO_DIR : 0)
+            | ((difference & drive::pack<linkFrames::x>(~0u)) ? CHANGED_X : 0);
+    command = next;
+    commandKnown = true;
+}
+
 bool Receiver433mhz::decodeMessage(uint8_t arr[]){
-    uint32_t fullMessage = arr[3] | (arr[2] << 8) | (arr[1] << 16) | (arr[0] << 24);
-    //hwlib::cout << "decimal fullmessage: " << fullMessage << hwlib::endl;
-    Checksum = fullMessage & 0b1111111111;
-    fullMessage = fullMessage >> 10;
-    servoDir = fullMessage & 0x01;
-    fullMessage = fullMessage >> 1;
-    Xval = fullMessage & 0b111111111;
-    fullMessage = fullMessage >> 9;
-    Yval = fullMessage & 0b1111111111;
-    fullMessage = fullMessage >> 10;
-    motorDir = fullMessage & 0x01;
-    fullMessage = fullMessage >> 1;
+    // the layouts and checksums come from linkFrames.hpp, the transmitter uses the same definitions
+    using drive = linkFrames::driveFrame;
+    using aux = linkFrames::auxFrame;
+    frameAddress = arr[0];
+    uint32_t fullMessage = drive::fromBytes(arr + 1);
+    frame = fullMessage;
+    auxFrame = !linkFrames::isDrive(fullMessage);
+    if (auxFrame) {
+        // the drive values are left alone
+        Checksum = aux::unpack<linkFrames::checksum>(fullMessage);
+        auxIndex = aux::unpack<linkFrames::auxIndex>(fullMessage);
+        auxValue = aux::unpack<linkFrames::auxValue>(fullMessage);
+        RCCAR_TRACE_POINT(tracePoint::FRAME_DECODED, Checksum);
+        return frameAddress == address && linkFrames::auxValid(fullMessage, frameAddress);
+    }
+    Checksum = drive::unpack<linkFrames::checksum>(fullMessage);
+    servoDir = drive::unpack<linkFrames::servoDir>(fullMessage);
+    Xval = drive::unpack<linkFrames::x>(fullMessage);
+    Yval = drive::unpack<linkFrames::y>(fullMessage);
+    motorDir = drive::unpack<linkFrames::motorDir>(fullMessage);
     //hwlib::cout << "motorDir: " << motorDir << " servoDir: " << servoDir << " Y: " << Yval << " X: " << Xval << " checksum: " << Checksum << hwlib::endl;
-    return checksum(Yval, ((Xval << 1) | (int) servoDir), Checksum);
+    RCCAR_TRACE_POINT(tracePoint::FRAME_DECODED, Checksum);
+    return frameAddress == address && linkFrames::driveValid(fullMessage, frameAddress);
 }
 
 bool Receiver433mhz::checksum(const uint16_t & left, const uint16_t & right, const uint16_t & XOR){
@@ -69,7 +140,7 @@ void Receiver433mhz::messageLoop(){
         validMessage = false;
     }
     if(!ReceiverLowFlag){
-        setReceiverLowFlag(input.read());
+        setReceiverLowFlag(readInput());
     }
 
     switch (state) {
@@ -78,7 +149,10 @@ void Receiver433mhz::messageLoop(){
          */
         case state_t::IDLE:
             if(ReceiverLowFlag) {
+                RCCAR_TRACE_POINT(tracePoint::FIRST_EDGE, 0);
                 count = 0;
+                // the first pulse has to be timed from scratch too, a message may start with a 0 now
+                time_start = 0;
                 state = state_t::TIMING;
             }
             break;
@@ -90,7 +164,7 @@ void Receiver433mhz::messageLoop(){
             if(time_start == 0){
                 time_start = hwlib::now_us();
             }
-            setReceiverHighFlag(!input.read());
+            setReceiverHighFlag(!readInput());
             if(ReceiverHighFlag){
                 time_end = hwlib::now_us();
                 setReceiverLowFlag(false);
@@ -115,10 +189,24 @@ void Receiver433mhz::messageLoop(){
             }
 
             // new bit took longer then 2ms and still no new pulse. When count is 8 the message is just a keepalive
-            // only true when waiting longer then 2 ms |  true when Flag is false |  if the counter is more then 8
-            if ((hwlib::now_us() - bitTimer > 2000) && !ReceiverLowFlag && count > 8) {
-                validMessage = decodeMessage(array);
-                for(size_t i = 0; i < count/8; i++) {
+            // only true when waiting longer then 2 ms |  true when Flag is false
+            if ((hwlib::now_us() - bitTimer > 2000) && !ReceiverLowFlag) {
+                // a keepalive has to be dropped here too, otherwise its bits end up in front of the next message.
+                // anything else that is not exactly one message long is damaged
+                if (count == MESSAGE_BITS) {
+                    validMessage = decodeMessage(array);
+                    if (validMessage) {
+                        updateChanges();
+                        stats.accepted++;
+                    } else {
+                        stats.rejected++;
+                    }
+                } else if (count == 8) {
+                    stats.keepalives++;
+                } else {
+                    stats.damaged++;
+                }
+                for(size_t i = 0; i < (count + 7u) / 8; i++) {
                     array[i] = 0x00;
                 }
                 state = state_t::IDLE;
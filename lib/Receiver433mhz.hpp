@@ -7,15 +7,33 @@
  *
  */
 
+#ifndef RCCAR_RECEIVER433MHZ_HPP
+#define RCCAR_RECEIVER433MHZ_HPP
+
 #include <hwlib.hpp>
+#include "latencyTrace.hpp"
+#include "linkFrames.hpp"
+#include "pulseCapture.hpp"
 
+/**
+ * \struct receiverStatistics. what a Receiver433mhz made of the pulses it timed
+ */
+struct receiverStatistics {
+    uint32_t accepted = 0;      /**< messages with a valid checksum for this address */
+    uint32_t rejected = 0;      /**< messages of the right length that failed the checksum or were for another address */
+    uint32_t damaged = 0;       /**< bursts that were neither a message nor a keepalive */
+    uint32_t keepalives = 0;    /**< bursts of exactly 8 bits */
+};
 
 class Receiver433mhz {
 private:
-    bool       ReceiverHighFlag;    /**< ReceiverHighFlag is a boolean that is set when the input value falls to indicate the duration of the pulse */
-    bool       ReceiverLowFlag;     /**< ReceiverLowFlag is a boolean that is set when a HIGH value is read and a timer is started */
+    bool       ReceiverHighFlag = false;    /**< ReceiverHighFlag is a boolean that is set when the input value falls to indicate the duration of the pulse */
+    bool       ReceiverLowFlag = false;     /**< ReceiverLowFlag is a boolean that is set when a HIGH value is read and a timer is started */
     uint_fast64_t      bitTimer;
     hwlib::pin_in      &input;
+    uint8_t            address;     /**< messages for other addresses are ignored */
+    pulseCapture *     capture = nullptr;   /**< when set, every edge of the input is recorded */
+    bool               inputLevel = false;  /**< last level read from the input */
 
     uint8_t array[64]  = {0};
     int     time_start = 0;
@@ -26,22 +44,69 @@ private:
     bool servoDir; // true being right
     uint16_t Yval; // unsigned int (0 - 1024)
     uint16_t Xval; // unsigned int (0 - 512)
-    uint16_t Checksum; // checksum of bits 2 to 32
+    uint16_t Checksum; // checksum of bits 2 to 32 and the address
+    uint8_t  frameAddress; // address the last message was sent to
+    bool     auxFrame = false; // the last message was an aux frame
+    uint8_t  auxIndex = 0; // aux field of the last aux frame
+    uint16_t auxValue = 0; // value of the last aux frame (0 - 4095)
+    uint32_t frame = 0; // the 32 bits after the address of the last message
+
+    uint32_t command = 0;           /**< drive fields of the last accepted drive frame, see getCommand() */
+    bool     commandKnown = false;  /**< a drive frame has been accepted */
+    uint16_t auxValues[16] = {0};   /**< value of every aux field, as last accepted */
+    uint16_t auxKnown = 0;          /**< aux fields that have been accepted, one bit per field */
+    uint8_t  changes = 0;           /**< fields the available message changed, see getChanges() */
 
     bool validMessage = false;
+    receiverStatistics stats;
 
     enum class state_t {
         IDLE, TIMING, TIMING_DONE
     };
     state_t state      = state_t::IDLE;
 
+    /**
+     * \brief read the input, and record the edge if it changed and a capture is set
+     */
+    bool readInput();
+
+    /**
+     * \brief compare an accepted message with the ones before it and fill in changes
+     */
+    void updateChanges();
+
 public:
     /**
      * \brief Standard constructor
      *
      * @param input input pin for an 433mhz receiver
+     * @param address address of this car, the remote has to use the same address
+     */
+    Receiver433mhz(hwlib::pin_in &input, uint8_t address = 1);
+
+    /**
+     * \brief number of bits in a message: an address byte followed by 32 bits of data
+     */
+    static constexpr uint8_t MESSAGE_BITS = linkFrames::FRAME_BYTES * 8;
+
+    /**
+     * \brief bits of getChanges(), one per field of the frames
      */
-    Receiver433mhz(hwlib::pin_in &input);
+    static constexpr uint8_t CHANGED_MOTOR_DIR = 0x01;
+    static constexpr uint8_t CHANGED_Y = 0x02;
+    static constexpr uint8_t CHANGED_SERVO_DIR = 0x04;
+    static constexpr uint8_t CHANGED_X = 0x08;
+    static constexpr uint8_t CHANGED_AUX = 0x10;       /**< the value of the aux field in the aux frame */
+    static constexpr uint8_t CHANGED_THROTTLE = CHANGED_MOTOR_DIR | CHANGED_Y;
+    static constexpr uint8_t CHANGED_STEERING = CHANGED_SERVO_DIR | CHANGED_X;
+
+    /**
+     * \brief record the raw edges of the input, for analysis with host/replay
+     * the edges are only seen when messageLoop() is called, so they carry its timing
+     *
+     * @param c the buffer to record to
+     */
+    void setCapture(pulseCapture & c);
 
     /**
      * \brief setter function for ReceiverLowFlag
@@ -77,13 +142,55 @@ public:
      */
     uint16_t getX();
 
+    /**
+     * \brief whether the available message is an aux frame instead of a drive frame
+     * an aux frame leaves the drive values as they were
+     */
+    bool isAux();
+
+    /**
+     * \brief getter for the aux field of the last aux frame
+     */
+    uint8_t getAuxIndex();
+
+    /**
+     * \brief getter for the value of the last aux frame
+     */
+    uint16_t getAuxValue();
+
     /**
      * \brief getter to check if a new message is available and unpacked to be send to the PCA board
      */
     bool messageAvailable();
 
+    /**
+     * \brief the drive values of the last accepted drive frame in one word
+     * laid out as linkFrames::driveFrame with the checksum left out, unpack it with driveFrame::unpack
+     */
+    uint32_t getCommand();
+
+    /**
+     * \brief the fields the available message changed, as CHANGED_ bits
+     * remotes repeat their values, a repeat has no bits set. the first drive frame changes all drive
+     * fields and the first aux frame for a field changes it
+     */
+    uint8_t getChanges();
+
+    /**
+     * \brief whether no burst is being received, the input was low since the last one ended.
+     * code that blocks the loop, like a PCA9685 write on the bit banged i2c bus, should wait for this,
+     * the pulses of a frame are timed by polling and are lost while the loop is blocked
+     */
+    bool quiet() const;
+
+    /**
+     * \brief counters of everything received since the start
+     */
+    const receiverStatistics & statistics() const;
+
     /**
      * \brief this function unpacks the given array into usable variables
+     * only messages with a valid checksum that are sent to the address of this receiver are accepted
      *
      * @param arr array of uint8_t's that are the equivalent of the full message sent by the transmitter
      */
@@ -104,3 +211,4 @@ public:
     void messageLoop();
 };
 
+#endif //RCCAR_RECEIVER433MHZ_HPP
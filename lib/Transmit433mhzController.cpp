@@ -15,19 +15,19 @@ Transmit433mhzController::Transmit433mhzController(hwlib::pin_out & transmitter)
 void Transmit433mhzController::send_one(){
     Transmitter.write(1);
     Transmitter.flush();
-	hwlib::wait_us(400);
+	hold(400);
     Transmitter.write(0);
     Transmitter.flush();
-	hwlib::wait_us(200);
+	hold(200);
 }
 
 void Transmit433mhzController::send_zero(){
     Transmitter.write(1);
     Transmitter.flush();
-	hwlib::wait_us(200);
+	hold(200);
     Transmitter.write(0);
     Transmitter.flush();
-	hwlib::wait_us(400);
+	hold(400);
 }
 
 void Transmit433mhzController::sendByte(uint8_t B){
@@ -46,7 +46,7 @@ void Transmit433mhzController::sendMessage(uint8_t data[], size_t size, int coun
 		for (size_t j = 0; j < size; j++) {
 			sendByte(data[j]);
 		}
-		hwlib::wait_ms(delay_ms);
+		hold(delay_ms * 1000);
 	}
 }
 
@@ -55,10 +55,50 @@ void Transmit433mhzController::keepAlive(){
     sendMessage(dummydata, 1, 1, 3);
 }
 
-constructMessage::constructMessage(hwlib::pin_out & transmitter):
-    transmitter(Transmit433mhzController( transmitter ))
+void Transmit433mhzController::waitForSlot(const slotScheduler & slots, uint32_t durationUs){
+    uint32_t wait = slots.waitTime(hwlib::now_us(), durationUs);
+    if (wait) {
+        hold(wait);
+    }
+}
+
+void Transmit433mhzController::setBackground(backgroundTask & task){
+    background = &task;
+}
+
+void Transmit433mhzController::hold(uint32_t us){
+    if (!background) {
+        hwlib::wait_us(us);
+        return;
+    }
+    uint_fast64_t end = hwlib::now_us() + us;
+    for (;;) {
+        background->poll();
+        uint_fast64_t now = hwlib::now_us();
+        if (now >= end) {
+            return;
+        }
+        hwlib::wait_us(end - now > POLL_SLICE_US ? POLL_SLICE_US : end - now);
+    }
+}
+
+constructMessage::constructMessage(hwlib::pin_out & transmitter, uint8_t address):
+    transmitter(Transmit433mhzController( transmitter )),
+    address(address)
 {}
 
+void constructMessage::setScheduler(slotScheduler & slots) {
+    scheduler = &slots;
+}
+
+void constructMessage::setBackground(backgroundTask & task) {
+    transmitter.setBackground(task);
+}
+
+const transmitterStatistics & constructMessage::statistics() const {
+    return stats;
+}
+
 void constructMessage::setMotorDir(bool dir) {
     motorDirection = dir;
     mdirFlag = true;
@@ -79,6 +119,13 @@ void constructMessage::setX(uint16_t xValue){
     XFlag = true;
 }
 
+void constructMessage::setAux(uint8_t index, uint16_t value){
+    if (index < AUX_FIELDS) {
+        auxValues[index] = value > 4095 ? 4095 : value;
+        auxPending |= 1u << index;
+    }
+}
+
 uint16_t constructMessage::adapter(const uint16_t & value, const uint16_t & oldMin, const uint16_t & oldMax, const uint16_t & newMin, const uint16_t & newMax) {
     return newMin + (float)(newMax - newMin) * ((float)(value - oldMin) / (float)(oldMax - oldMin));
 }
@@ -88,42 +135,63 @@ uint16_t constructMessage::makeChecksum(const uint16_t & left, const uint16_t &
 }
 
 void constructMessage::makeMessage(){
-    if ( (mdirFlag && sdirFlag && YFlag && XFlag) || (mdirFlag && YFlag) || (sdirFlag && XFlag) ){
-        if(YFlag){
-            Y = adapter(Y, (uint16_t)0, (uint16_t)4095, (uint16_t)0, (uint16_t)1023);
+    bool drive = (mdirFlag && sdirFlag && YFlag && XFlag) || (mdirFlag && YFlag) || (sdirFlag && XFlag);
+    if (drive || auxPending){
+        uint8_t aux = 0;
+        if (drive) {
+            // only a drive frame scales, an aux frame leaves a value that waits for its direction as it was set
+            if(YFlag){
+                Y = adapter(Y, (uint16_t)0, (uint16_t)4095, (uint16_t)0, (uint16_t)1023);
+            }
+            if(XFlag) {
+                X = adapter(X, (uint16_t) 0, (uint16_t) 4095, (uint16_t) 0, (uint16_t) 511);
+            }
+            encodeMessage();
+        } else {
+            aux = __builtin_ctz(auxPending);
+            encodeAuxMessage(aux);
         }
-        if(XFlag) {
-            X = adapter(X, (uint16_t) 0, (uint16_t) 4095, (uint16_t) 0, (uint16_t) 511);
+        RCCAR_TRACE_POINT(tracePoint::FRAME_ENCODED, XOR);
+
+        if (scheduler) {
+            // every bit takes 600us on air
+            transmitter.waitForSlot(*scheduler, MESSAGE_BYTES * 8 * 600);
         }
-        XOR = makeChecksum(Y, ((X<<1)|servoDirection));
-
-        uint32_t fullMessage = 0x01;
-        fullMessage = fullMessage << 1;
-        fullMessage = fullMessage | motorDirection;
-        fullMessage = fullMessage << 10;
-        fullMessage = fullMessage | Y;
-        fullMessage = fullMessage << 9;
-        fullMessage = fullMessage | X;
-        fullMessage = fullMessage << 1;
-        fullMessage = fullMessage | servoDirection;
-        fullMessage = fullMessage << 10;
-        fullMessage = fullMessage | XOR;
-
-        //use MSB / big endian to put the fullMessage into 4 uint8_t places of transmitData
-        transmitData[0] = fullMessage >> 24;
-        transmitData[1] = fullMessage >> 16;
-        transmitData[2] = fullMessage >> 8;
-        transmitData[3] = fullMessage;
 
         //delay the next message with 6ms to allow the i2c code to be send before the start of the next message
-        transmitter.sendMessage(transmitData, 4, 1, 6);
-
-        mdirFlag = false;
-        sdirFlag = false;
-        YFlag = false;
-        XFlag = false;
-    } else {
-        // If no flags set, set out a keepalive signal to stop noise from accumulating
+        transmitter.sendMessage(transmitData, MESSAGE_BYTES, 1, 6);
+
+        if (drive) {
+            stats.driveFrames++;
+            mdirFlag = false;
+            sdirFlag = false;
+            YFlag = false;
+            XFlag = false;
+        } else {
+            stats.auxFrames++;
+            auxPending &= ~(1u << aux);
+        }
+    } else if (!scheduler || scheduler->fits(8 * 600)) {
+        // If no flags set, set out a keepalive signal to stop noise from accumulating.
+        // with a scheduler only in the own slot, a keepalive is never waited for
         transmitter.keepAlive();
+        stats.keepalives++;
     }
+}
+
+void constructMessage::encodeMessage(){
+    // the layout and the checksum come from linkFrames.hpp, the receiver uses the same definitions
+    XOR = linkFrames::driveChecksum(motorDirection, Y, X, servoDirection, address);
+    transmitData[0] = address;
+    linkFrames::driveFrame::toBytes(linkFrames::packDrive(motorDirection, Y, X, servoDirection, address), transmitData + 1);
+}
+
+void constructMessage::encodeAuxMessage(uint8_t index){
+    XOR = linkFrames::auxChecksum(index, auxValues[index], address);
+    transmitData[0] = address;
+    linkFrames::auxFrame::toBytes(linkFrames::packAux(index, auxValues[index], address), transmitData + 1);
+}
+
+const uint8_t * constructMessage::getMessage() const {
+    return transmitData;
 }
\ No newline at end of file
@@ -7,13 +7,34 @@
  *
  */
 
+#ifndef RCCAR_TRANSMIT433MHZCONTROLLER_HPP
+#define RCCAR_TRANSMIT433MHZCONTROLLER_HPP
+
 #include <hwlib.hpp>
+#include "latencyTrace.hpp"
+#include "slotScheduler.hpp"
+#include "linkFrames.hpp"
+#include "backgroundTask.hpp"
 
 
 class Transmit433mhzController{
 	hwlib::pin_out & Transmitter;
+	backgroundTask * background = nullptr;
+
+	/**
+	 * \brief longest stretch of a wait without a poll of the background task
+	 */
+	static constexpr uint32_t POLL_SLICE_US = 200;
 
 protected:
+	/**
+	 * \brief wait between two edges, polling the background task meanwhile.
+	 * the edge after the wait stays on time as long as a poll is shorter than the wait
+	 *
+	 * @param us time to wait in us
+	 */
+	void hold(uint32_t us);
+
 	/**
 	 * \brief send a 1 over 433mhz
 	 */
@@ -55,25 +76,86 @@ public:
      * this function will send out a bunch of zero's to keep the connection alive
      */
     void keepAlive();
+
+    /**
+     * \brief wait until a transmission fits in the slot of this remote, polling the background task meanwhile
+     *
+     * @param slots the time slots of the band
+     * @param durationUs air time of the transmission
+     */
+    void waitForSlot(const slotScheduler & slots, uint32_t durationUs);
+
+    /**
+     * \brief poll a task in the waits between the edges, so it keeps running while a message is on air
+     *
+     * @param task the task, it has to outlive the transmitter
+     */
+    void setBackground(backgroundTask & task);
+};
+
+/**
+ * \struct transmitterStatistics. what a constructMessage put on air
+ */
+struct transmitterStatistics {
+    uint32_t driveFrames = 0;   /**< messages with drive values */
+    uint32_t auxFrames = 0;     /**< messages with an aux field */
+    uint32_t keepalives = 0;    /**< keepalives sent because there was nothing to send */
 };
 
 class constructMessage {
 private:
     Transmit433mhzController transmitter;                   /**< transmit433mhz class for intern use */
-    uint8_t transmitData[4] = { 0x00, 0x00, 0x00, 0x00 };   /**< array of 4 uint8_t that make up a complete message */
+    uint8_t address;                                        /**< address of the car this remote drives */
+    slotScheduler * scheduler = nullptr;                    /**< when set, frames are only sent in the slot of this remote */
+    uint8_t transmitData[linkFrames::FRAME_BYTES] = {0};   /**< the address and the frame that make up a complete message */
     uint16_t X = 0;                                         /**< uint16_t value of X */
     uint16_t Y = 0;                                         /**< uint16_t value of Y */
     uint16_t XOR = 0;                                       /**< uint16_t value of XOR */
+    uint16_t auxValues[16] = {0};                           /**< last value set for every aux field */
+    uint16_t auxPending = 0;                                /**< aux fields that still have to be sent, one bit each */
     bool mdirFlag = false, sdirFlag = false, YFlag = false, XFlag = false, motorDirection = true, servoDirection = false;
+    transmitterStatistics stats;                            /**< see statistics() */
 
 public:
     /**
      * \brief Standard constructor
      *
      * @param transmitter pin of transmitter to output to.
+     * @param address address of the car to drive, the receiver of that car has to use the same address
      * the constructor creates it's own Transmit433mhzController using the transmitterPin provided
      */
-    constructMessage(hwlib::pin_out & transmitter);
+    constructMessage(hwlib::pin_out & transmitter, uint8_t address = 1);
+
+    /**
+     * \brief number of bytes in a message: the address followed by 32 bits of data
+     */
+    static constexpr size_t MESSAGE_BYTES = linkFrames::FRAME_BYTES;
+
+    /**
+     * \brief number of aux fields, each can drive one spare output on the car
+     */
+    static constexpr uint8_t AUX_FIELDS = 16;
+
+    /**
+     * \brief share the band with other remotes by only sending in an own time slot
+     * without a scheduler keepalives are sent between messages, with one they are left out
+     * because they would land in the slots of the other remotes
+     *
+     * @param slots the scheduler to wait for before every message
+     */
+    void setScheduler(slotScheduler & slots);
+
+    /**
+     * \brief keep a task running while a message is on air, see Transmit433mhzController::setBackground
+     *
+     * @param task the task, it has to outlive this object
+     */
+    void setBackground(backgroundTask & task);
+
+    /**
+     * \brief counters of everything sent since the start
+     */
+    const transmitterStatistics & statistics() const;
 
     /**
      * \brief Set the motor direction
@@ -103,6 +185,14 @@ public:
      */
     void setX(uint16_t xValue);
 
+    /**
+     * \brief Set an aux value, it is sent in its own frame once no drive values are waiting
+     *
+     * @param index aux field, smaller than AUX_FIELDS
+     * @param value 0 to 4095, what it means depends on the output at the car
+     */
+    void setAux(uint8_t index, uint16_t value);
+
     /**
 	 * \brief function to adapt a input variable from it's max range of numbers to a comparable new value within a new range
 	 *
@@ -125,9 +215,32 @@ public:
 	 */
     static uint16_t makeChecksum(const uint16_t & left, const uint16_t & right);
 
+    /**
+     * \brief packs the current values into the 4 byte message without sending it.
+     * X and Y should already be scaled to their 9 and 10 bit range, makeMessage takes care of that
+     */
+    void encodeMessage();
+
+    /**
+     * \brief packs an aux field into the 4 byte message without sending it.
+     * see linkFrames::auxFrame for the layout
+     *
+     * @param index aux field to pack
+     */
+    void encodeAuxMessage(uint8_t index);
+
+    /**
+     * \brief getter for the last encoded message
+     * @return array of MESSAGE_BYTES uint8_t's, most significant byte first
+     */
+    const uint8_t * getMessage() const;
+
     /**
      * \brief this function need to be called repeatedly in order to check if there are new values to be sent out
+     * drive values go first, otherwise the lowest pending aux field is sent, one frame per call.
      * note that this function sends out a keepalive signal to the 433mhz transmitter to idle the 433mhz chip
      */
     void makeMessage();
 };
+
+#endif //RCCAR_TRANSMIT433MHZCONTROLLER_HPP
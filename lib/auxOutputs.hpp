@@ -0,0 +1,139 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_AUXOUTPUTS_HPP
+#define RCCAR_AUXOUTPUTS_HPP
+
+#include "hwlib.hpp"
+#include "PCA9685.hpp"
+
+/**
+ * \brief what is connected to an aux pin
+ */
+enum class auxType : uint8_t {
+    SWITCH,     /**< on or off, lights for instance. any value above 0 is on */
+    PWM,        /**< duty cycle, the value is the number of ticks out of 4096 */
+    SERVO       /**< hobby servo, the value 0 to 4095 is spread over usMin to usMax */
+};
+
+/**
+ * \struct auxChannel. connects one aux field of the protocol to a pin of the PCA9685
+ */
+struct auxChannel {
+    uint8_t pin;                /**< pin on the PCA9685, 0 to 15 */
+    auxType type;
+    bool invert = false;        /**< for SWITCH and PWM outputs that are active low */
+    uint16_t usMin = 1000;      /**< pulse length at value 0, SERVO only */
+    uint16_t usMax = 2000;      /**< pulse length at value 4095, SERVO only */
+};
+
+/**
+ * \brief the pins used by a table of aux channels, as a mask, for compile time checks
+ * a table with a pin that does not exist or with a pin used twice gives 0xFFFF,
+ * which collides with everything
+ */
+template<size_t N>
+constexpr uint16_t auxPins(const auxChannel (&channels)[N]) {
+    uint16_t pins = 0;
+    for (size_t i = 0; i < N; i++) {
+        if (channels[i].pin > 15 || (pins & (1u << channels[i].pin))) {
+            return 0xFFFF;
+        }
+        pins |= 1u << channels[i].pin;
+    }
+    return pins;
+}
+
+/**
+ * \brief the pins of a table of aux channels that are pulsed, the PWM and SERVO channels.
+ * a SWITCH is fully on or off and has no on-time to stagger, see PCA9685_i2c::staggerPhases
+ */
+template<size_t N>
+constexpr uint16_t pulsedAuxPins(const auxChannel (&channels)[N]) {
+    uint16_t pins = 0;
+    for (size_t i = 0; i < N; i++) {
+        if (channels[i].type != auxType::SWITCH) {
+            pins |= 1u << (channels[i].pin & 0x0F);
+        }
+    }
+    return pins;
+}
+
+namespace auxCheck {
+    constexpr auxChannel mixed[] = { { 4, auxType::SWITCH }, { 5, auxType::SERVO }, { 7, auxType::PWM } };
+    static_assert(pulsedAuxPins(mixed) == ((1u << 5) | (1u << 7)), "a switch has no on-time to stagger");
+}
+
+/**
+ * \class auxOutputs. drives the spare PCA9685 pins from the aux fields in the frames of the remote
+ * aux field n is sent to the n-th channel of the table, fields without a channel are ignored.
+ * inside a PCA9685_i2c batch the aux pins are written together with the drive pins.
+ */
+class auxOutputs {
+private:
+    PCA9685_i2c & PCA;
+    const auxChannel * channels;
+    uint8_t count;
+    uint16_t lit = 0;           /**< aux fields whose SWITCH or PWM output is on, one bit per field */
+
+public:
+    /**
+     * \brief Standard constructor
+     *
+     * @param pca reference to the PCA object the aux pins are on
+     * @param channels table with one entry per aux field, it has to outlive this object
+     * @param count number of entries in the table
+     */
+    auxOutputs(PCA9685_i2c & pca, const auxChannel * channels, uint8_t count):
+        PCA(pca),
+        channels(channels),
+        count(count)
+    {}
+
+    /**
+     * \brief set the output of an aux field
+     *
+     * @param index the aux field, as sent by constructMessage::setAux
+     * @param value 0 to 4095
+     */
+    void set(uint8_t index, uint16_t value) {
+        if (index >= count) {
+            return;
+        }
+        const auxChannel & c = channels[index];
+        value = value > 4095 ? 4095 : value;
+        if (c.type != auxType::SERVO && value) {
+            lit |= 1u << index;
+        } else {
+            lit &= ~(1u << index);
+        }
+        switch (c.type) {
+            case auxType::SWITCH:
+                PCA.setPin(c.pin, value ? 4095 : 0, c.invert);
+                break;
+            case auxType::PWM:
+                PCA.setPin(c.pin, value, c.invert);
+                break;
+            case auxType::SERVO:
+                PCA.writeMicroseconds(c.pin, c.usMin + (int32_t) (c.usMax - c.usMin) * value / 4095);
+                break;
+        }
+    }
+
+    /**
+     * \brief whether a SWITCH or PWM output is on, the lights go off when the PCA9685 sleeps.
+     * servos do not count: asleep they get no pulses and stop holding their position. that is fine
+     * for a gearbox servo of a car that stands still, a servo that holds a load should keep the PCA9685 awake
+     */
+    bool anyOn() const {
+        return lit != 0;
+    }
+};
+
+#endif //RCCAR_AUXOUTPUTS_HPP
@@ -0,0 +1,50 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_BACKGROUNDTASK_HPP
+#define RCCAR_BACKGROUNDTASK_HPP
+
+/**
+ * \class backgroundTask. work that goes on while a blocking part of the loop waits
+ * the Due runs without an OS, so code that waits, like the transmitter between two edges,
+ * calls poll() in its waits instead. poll() decides itself whether there is something to do
+ * and has to return quickly, well within the shortest wait of the caller.
+ */
+class backgroundTask {
+public:
+    /**
+     * \brief do the work that is due, if any
+     */
+    virtual void poll() = 0;
+};
+
+/**
+ * \class backgroundPair. two tasks that share one waiting caller, polled in order
+ */
+class backgroundPair : public backgroundTask {
+private:
+    backgroundTask & first;
+    backgroundTask & second;
+
+public:
+    /**
+     * \brief Standard constructor, both tasks have to outlive the pair
+     */
+    backgroundPair(backgroundTask & first, backgroundTask & second):
+        first(first),
+        second(second)
+    {}
+
+    void poll() override {
+        first.poll();
+        second.poll();
+    }
+};
+
+#endif //RCCAR_BACKGROUNDTASK_HPP
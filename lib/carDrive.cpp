@@ -0,0 +1,121 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "carDrive.hpp"
+
+using namespace driveSetup;
+
+carDrive::carDrive(Receiver433mhz & receiver, PCA9685_i2c & PCA, hwlib::pin_in & tachoPin,
+                   const predictorSettings & prediction):
+    receiver(receiver),
+    PCA(PCA),
+    motor(PCA),
+    tacho(tachoPin),
+    speed(tacho, motor, speedGains, CONTROL_PERIOD_US),
+    ser(PCA),
+    aux(PCA, auxChannels, AUX_CHANNELS),
+    steeringCommand(rangeMin + 1, rangeMax, prediction),
+    throttleCommand(-MAX_SPEED, MAX_SPEED, prediction)
+{}
+
+void carDrive::begin() {
+    //  Initialize the PCA9685 with the values for this project
+    PCA.begin();
+    PCA.setOscillatorFrequency(27000000);
+    PCA.setPWMFreq(50);
+    hwlib::wait_ms(10);
+
+    // the speed controller stops and slows down from far too fast by braking
+    speed.setStopMode(stopMode::BRAKE);
+
+    PCA.staggerPhases(STAGGERED_PINS);
+    PCA.setDeadband(SERVOPIN, SERVO_DEADBAND);
+    PCA.setDeadband(PWMPIN, MOTOR_DEADBAND);
+
+    nextOutput = hwlib::now_us();
+    lastChange = hwlib::now_us();
+}
+
+void carDrive::receive() {
+    if (!receiver.messageAvailable()) {
+        return;
+    }
+    // the remote repeats its values, a frame that changes nothing keeps the PCA9685 asleep and the aux pins as they are
+    uint8_t changes = receiver.getChanges();
+    if (changes) {
+        lastChange = hwlib::now_us();
+    }
+
+    if (receiver.isAux()) {
+        if (changes & Receiver433mhz::CHANGED_AUX) {
+            PCA.beginBatch();
+            aux.set(receiver.getAuxIndex(), receiver.getAuxValue());
+            if (!auxWaiting) {
+                auxStaged = hwlib::now_us();
+                auxWaiting = true;
+            }
+        }
+    } else {
+        // repeats go in too, they tell the predictors that the stick stopped
+        int32_t x = receiver.getX() * (receiver.getServoDir() == 0 ? -1 : 1);
+        int32_t y = (receiver.getMotorDir() ? 1 : -1) * (int32_t) receiver.getY() * MAX_SPEED / 1023;
+        steeringCommand.received(x, hwlib::now_us());
+        throttleCommand.received(y, hwlib::now_us());
+    }
+}
+
+bool carDrive::actuate() {
+    bool steered = false;
+    // the writes block the loop, they wait until no frame is on its way in
+    if (steeringCommand.available() && hwlib::now_us() >= nextOutput && receiver.quiet()) {
+        uint_fast64_t now = hwlib::now_us();
+        nextOutput = now - nextOutput < OUTPUT_PERIOD_US ? nextOutput + OUTPUT_PERIOD_US : now + OUTPUT_PERIOD_US;
+
+        // the throttle is a speed now, the speed controller drives the motor
+        speed.setTarget(throttleCommand.value(now));
+
+        // the servo, and any aux pins that are waiting, change in one transaction
+        int32_t x = steeringCommand.value(now);
+        uint16_t pulse = ser.mapInverse(x);
+        if (pulse != steeringPulse) {
+            PCA.beginBatch();
+            ser.setPosition(pulse);
+            steeringValue = x;
+            steeringPulse = pulse;
+            steered = true;
+        }
+    }
+    if (steered) {
+        PCA.endBatch();
+        auxWaiting = false;
+    } else if (auxWaiting && hwlib::now_us() - auxStaged > AUX_HOLD_US && receiver.quiet()) {
+        PCA.endBatch();
+        auxWaiting = false;
+    }
+    return steered;
+}
+
+bool carDrive::control() {
+    // a motor update joins the aux values that are waiting, and takes them along right away
+    bool written = speed.loop(receiver.quiet());
+    if (written && PCA.inBatch()) {
+        PCA.endBatch();
+        auxWaiting = false;
+    }
+
+    if (!PCA.sleeping() && !PCA.inBatch() && speed.getTarget() == 0 && speed.getMeasured() == 0
+        && !aux.anyOn() && hwlib::now_us() - lastChange > STANDSTILL_SLEEP_US && receiver.quiet()) {
+        PCA.sleep();
+    } else if (PCA.sleeping() && speed.getMeasured() != 0 && receiver.quiet()) {
+        // the sleeping chip let go of the brake and the car rolls. the shadow registers still hold
+        // the brake, so setVelocity(0) writes nothing, the restart of wakeup() brings it back
+        PCA.wakeup();
+    }
+    return written;
+}
@@ -0,0 +1,103 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_CARDRIVE_HPP
+#define RCCAR_CARDRIVE_HPP
+
+#include "hwlib.hpp"
+#include "PCA9685.hpp"
+#include "Receiver433mhz.hpp"
+#include "driveSetup.hpp"
+
+/**
+ * \class carDrive. what the car does with the frames it receives, from the receiver to the PCA9685
+ * the drive frames go into the predictors, the steering and the speed target follow them every
+ * OUTPUT_PERIOD_US, the speed controller drives the motor and the aux frames set the spare pins.
+ * every PCA9685 write waits until the receiver is quiet, a bit banged i2c transaction in the middle
+ * of a frame loses that frame. mainCar.cpp calls receive(), actuate() and control() once per loop,
+ * host/vehiclesim does the same on a simulated board.
+ */
+class carDrive {
+private:
+    Receiver433mhz & receiver;
+    PCA9685_i2c & PCA;
+    driveSetup::motorDriver motor;
+    tachometer tacho;
+    driveSetup::speedLoop speed;
+    driveSetup::steeringServo ser;
+    auxOutputs aux;
+    commandPredictor steeringCommand;
+    commandPredictor throttleCommand;
+
+    uint_fast64_t nextOutput = 0;
+    int32_t steeringValue = 0;
+    uint16_t steeringPulse = 0;
+    uint_fast64_t auxStaged = 0;
+    bool auxWaiting = false;
+    uint_fast64_t lastChange = 0;
+
+public:
+    /**
+     * \brief Standard constructor
+     *
+     * @param receiver the receiver of the frames, its messageLoop is called by the owner
+     * @param PCA the PCA9685 the motor driver, the servo and the aux outputs are on
+     * @param tachoPin input of the speed sensor
+     * @param prediction how the predictors fill the time between frames
+     */
+    carDrive(Receiver433mhz & receiver, PCA9685_i2c & PCA, hwlib::pin_in & tachoPin,
+             const predictorSettings & prediction = driveSetup::commandPrediction);
+
+    /**
+     * \brief initialize the PCA9685 and the outputs, before the loop
+     */
+    void begin();
+
+    /**
+     * \brief take the frame the receiver has, if there is one. call it after messageLoop
+     */
+    void receive();
+
+    /**
+     * \brief update the speed target and the servo when an output is due, with any aux values that wait
+     *
+     * @return whether the servo was written
+     */
+    bool actuate();
+
+    /**
+     * \brief run the speed controller, send aux values that waited too long and sleep the PCA9685 at standstill
+     *
+     * @return whether the speed controller wrote the motor
+     */
+    bool control();
+
+    /**
+     * \brief the speed controller, for its target, measured speed and output
+     */
+    const driveSetup::speedLoop & speedController() const {
+        return speed;
+    }
+
+    /**
+     * \brief the steering the servo was last set to, in the range of the frames
+     */
+    int32_t steering() const {
+        return steeringValue;
+    }
+
+    /**
+     * \brief the pulse the servo was last set to, in us
+     */
+    uint16_t servoPulse() const {
+        return steeringPulse;
+    }
+};
+
+#endif //RCCAR_CARDRIVE_HPP
@@ -0,0 +1,162 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_CHANNELSCHEDULER_HPP
+#define RCCAR_CHANNELSCHEDULER_HPP
+
+#include <hwlib.hpp>
+
+/**
+ * \class channelScheduler. decides which logical channels go into the next frame
+ * every channel has a minimum interval between two updates, which caps its rate, a priority
+ * and the group of the frame it travels in. a channel is due when its value changed and its
+ * interval has passed, or when it has not been sent for its refresh time, so a lost frame
+ * does not leave a stale value at the car forever.
+ * the due channel with the highest priority picks the frame group; every changed channel of
+ * that group rides along, even the ones that are not due yet, since the frame carries them anyway.
+ * a channel that gets its values through update() adapts its rate to how far the value moved from
+ * what the car has: a move of fullRateDelta or more goes out after intervalUs, a smaller one waits
+ * proportionally longer, so fast stick motion bursts at the highest rate while the noise of a held
+ * stick only rides along with the refresh. the refresh caps how stale the value at the car can get.
+ *
+ * @tparam CHANNELS number of logical channels, at most 32
+ */
+template<size_t CHANNELS>
+class channelScheduler {
+    static_assert(CHANNELS > 0 && CHANNELS <= 32, "the channels of a frame are kept in a 32 bit mask");
+
+private:
+    /**
+     * \struct channel. configuration and state of one logical channel
+     */
+    struct channel {
+        uint32_t intervalUs = 0;        /**< minimum time between two updates */
+        uint32_t refreshUs = 0;         /**< resend an unchanged value after this long, 0 for never */
+        uint8_t priority = 0;           /**< 0 is the highest priority */
+        uint8_t group = 0;              /**< frame group the channel is sent in */
+        uint16_t fullRateDelta = 0;     /**< change that is sent at the highest rate, 0 for every change */
+        int32_t value = 0;              /**< last value passed to update() */
+        int32_t sentValue = 0;          /**< value in the last frame of the channel */
+        uint_fast64_t lastSent = 0;
+        bool changed = false;           /**< marked by changed(), sent at the highest rate */
+        bool everSent = false;
+    };
+
+    channel channels[CHANNELS];
+
+    static bool pending(const channel & c) {
+        return c.changed || c.value != c.sentValue;
+    }
+
+    static uint_fast64_t wait(const channel & c) {
+        uint32_t delta = c.value > c.sentValue ? c.value - c.sentValue : c.sentValue - c.value;
+        if (c.changed || !c.fullRateDelta || delta >= c.fullRateDelta) {
+            return c.intervalUs;
+        }
+        return (uint_fast64_t) c.intervalUs * c.fullRateDelta / delta;
+    }
+
+    bool due(const channel & c, uint_fast64_t now) const {
+        if (!c.everSent) {
+            return true;
+        }
+        uint_fast64_t age = now - c.lastSent;
+        return (pending(c) && age >= wait(c)) || (c.refreshUs && age >= c.refreshUs);
+    }
+
+public:
+    /**
+     * \brief set up one channel, channels that are not configured are due at every frame of group 0
+     *
+     * @param index the channel, smaller than CHANNELS
+     * @param intervalUs minimum time between two updates, the inverse of the highest update rate
+     * @param priority 0 is the highest, decides which frame group goes first when several are due
+     * @param group frame group the channel is sent in
+     * @param refreshUs resend an unchanged value after this long, 0 for never
+     */
+    void configure(size_t index, uint32_t intervalUs, uint8_t priority, uint8_t group = 0, uint32_t refreshUs = 0) {
+        channels[index].intervalUs = intervalUs;
+        channels[index].priority = priority;
+        channels[index].group = group;
+        channels[index].refreshUs = refreshUs;
+    }
+
+    /**
+     * \brief let a channel adapt its rate to the size of its changes, see update()
+     *
+     * @param index the channel, smaller than CHANNELS
+     * @param fullRateDelta a change of at least this much is sent after intervalUs, a change of half
+     * of it after twice intervalUs and so on. 0 sends every change after intervalUs
+     */
+    void adapt(size_t index, uint16_t fullRateDelta) {
+        channels[index].fullRateDelta = fullRateDelta;
+    }
+
+    /**
+     * \brief tell the scheduler the value of a channel has changed, it is sent at the highest rate
+     */
+    void changed(size_t index) {
+        channels[index].changed = true;
+    }
+
+    /**
+     * \brief give the scheduler the current value of a channel, call it every loop.
+     * the channel is pending while the value differs from the value in its last frame
+     *
+     * @param index the channel, smaller than CHANNELS
+     * @param value the value as it would go into the frame, in any scale the fullRateDelta is in
+     */
+    void update(size_t index, int32_t value) {
+        channels[index].value = value;
+    }
+
+    /**
+     * \brief the channels that go into the next frame
+     *
+     * @param now current time in us
+     * @return a mask with bit n set for channel n, 0 when no frame needs to be sent
+     */
+    uint32_t pack(uint_fast64_t now) const {
+        int first = -1;
+        for (size_t i = 0; i < CHANNELS; i++) {
+            if (due(channels[i], now) && (first < 0 || channels[i].priority < channels[first].priority)) {
+                first = i;
+            }
+        }
+        if (first < 0) {
+            return 0;
+        }
+        uint32_t mask = 0;
+        for (size_t i = 0; i < CHANNELS; i++) {
+            if (channels[i].group == channels[first].group && (pending(channels[i]) || due(channels[i], now))) {
+                mask |= 1u << i;
+            }
+        }
+        return mask;
+    }
+
+    /**
+     * \brief mark the channels of a frame as sent
+     *
+     * @param mask channels in the frame, as returned by pack()
+     * @param now time the frame was sent, in us
+     */
+    void sent(uint32_t mask, uint_fast64_t now) {
+        for (size_t i = 0; i < CHANNELS; i++) {
+            if (mask & (1u << i)) {
+                channels[i].lastSent = now;
+                channels[i].sentValue = channels[i].value;
+                channels[i].changed = false;
+                channels[i].everSent = true;
+            }
+        }
+    }
+};
+
+#endif //RCCAR_CHANNELSCHEDULER_HPP
@@ -0,0 +1,139 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_COMMANDPREDICTOR_HPP
+#define RCCAR_COMMANDPREDICTOR_HPP
+
+#include <stdint.h>
+
+/**
+ * \struct predictorSettings. how a commandPredictor fills the time between two commands
+ */
+struct predictorSettings {
+    int32_t lookAheadUs;        /**< the line through the last two commands is evaluated this far ahead of now.
+                                     0 follows the line from the last command on, a negative look-ahead of one
+                                     frame interval interpolates between the last two commands, one frame late */
+    uint32_t maxAheadUs;        /**< furthest past the last command the line is followed, 0 never extrapolates */
+    uint32_t holdAfterUs;       /**< without a command for this long the last command is held as it is */
+};
+
+/**
+ * \class commandPredictor. one channel of commands as a smooth output between frames
+ * frames bring a command every 30ms or more, an output that is updated faster than that
+ * asks value() where the command would be now: on the line through the last two commands,
+ * shifted by the look-ahead and clamped to the range of the channel. a command that came after
+ * a pause of more than holdAfterUs starts a new line, so a held stick is not extrapolated from
+ * an old value, and once the commands stop for holdAfterUs the output holds the last one.
+ * a repeat of the same command flattens the line, the output stops where the stick stopped.
+ * times are in us, passed in by the caller.
+ */
+class commandPredictor {
+private:
+    predictorSettings settings;
+    int32_t minimum, maximum;
+    int32_t last = 0, before = 0;           /**< the last two commands */
+    uint_fast64_t lastUs = 0, beforeUs = 0; /**< when they came */
+    bool known = false;
+    bool sloped = false;                    /**< the last two commands make a line */
+
+    constexpr int32_t clamp(int64_t value) const {
+        return value < minimum ? minimum : value > maximum ? maximum : value;
+    }
+
+public:
+    /**
+     * \brief Standard constructor
+     *
+     * @param minimum, maximum range of the commands and of the output
+     * @param settings see predictorSettings
+     */
+    constexpr commandPredictor(int32_t minimum, int32_t maximum, const predictorSettings & settings):
+        settings(settings),
+        minimum(minimum),
+        maximum(maximum)
+    {}
+
+    /**
+     * \brief a command came in
+     *
+     * @param value the command, clamped to the range
+     * @param now time it came in
+     */
+    constexpr void received(int32_t value, uint_fast64_t now) {
+        sloped = known && now > lastUs && now - lastUs <= settings.holdAfterUs;
+        before = last;
+        beforeUs = lastUs;
+        last = clamp(value);
+        lastUs = now;
+        known = true;
+    }
+
+    /**
+     * \brief whether a command came in at all, the output means nothing before that
+     */
+    constexpr bool available() const {
+        return known;
+    }
+
+    /**
+     * \brief the last command as it came in
+     */
+    constexpr int32_t command() const {
+        return last;
+    }
+
+    /**
+     * \brief the output for a moment after the last command
+     */
+    constexpr int32_t value(uint_fast64_t now) const {
+        if (!sloped || now - lastUs > settings.holdAfterUs) {
+            return last;
+        }
+        int64_t interval = lastUs - beforeUs;
+        int64_t along = (int64_t) (now - lastUs) + settings.lookAheadUs;
+        // not further back than the command before, not further ahead than maxAheadUs
+        along = along < -interval ? -interval : along;
+        along = along > (int64_t) settings.maxAheadUs ? settings.maxAheadUs : along;
+        return clamp(last + (int64_t) (last - before) * along / interval);
+    }
+};
+
+namespace predictorCheck {
+    constexpr int32_t follow(const predictorSettings & settings, uint_fast64_t at) {
+        commandPredictor p(-100, 100, settings);
+        p.received(0, 1000);
+        p.received(30, 31000);
+        return p.value(at);
+    }
+    constexpr predictorSettings ahead = { 10000, 20000, 100000 };
+    constexpr predictorSettings behind = { -30000, 0, 100000 };
+    static_assert(follow(ahead, 31000) == 40 && follow(ahead, 41000) == 50 && follow(ahead, 61000) == 50,
+                  "extrapolation does not follow the line up to its limit");
+    static_assert(follow(behind, 31000) == 0 && follow(behind, 46000) == 15 && follow(behind, 71000) == 30,
+                  "interpolation does not run from the command before to the last one");
+    static_assert(follow(ahead, 132000) == 30, "the last command is not held once the commands stop");
+
+    constexpr int32_t afterPause() {
+        commandPredictor p(-100, 100, ahead);
+        p.received(0, 1000);
+        p.received(90, 500000);
+        return p.value(510000);
+    }
+    static_assert(afterPause() == 90, "a command after a pause is extrapolated from a stale one");
+
+    constexpr int32_t clamped() {
+        commandPredictor p(-100, 100, ahead);
+        p.received(60, 1000);
+        p.received(90, 11000);
+        return p.value(21000);
+    }
+    static_assert(clamped() == 100, "the output leaves the range of the channel");
+}
+
+#endif //RCCAR_COMMANDPREDICTOR_HPP
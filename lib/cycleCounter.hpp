@@ -0,0 +1,52 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_CYCLECOUNTER_HPP
+#define RCCAR_CYCLECOUNTER_HPP
+
+#include <hwlib.hpp>
+
+/**
+ * \class cycleCounter. free running 32 bit counter for timing short stretches of code
+ * on the target this is the DWT cycle counter of the Cortex-M3 (84 counts per us),
+ * on the host it is the virtual clock in nanoseconds (1000 counts per us).
+ * differences between two readings are valid as long as they are shorter than one wrap.
+ */
+class cycleCounter {
+public:
+#ifdef HWLIB_HOST
+    static constexpr uint32_t CYCLES_PER_US = 1000;
+#else
+    static constexpr uint32_t CYCLES_PER_US = 84;
+#endif
+
+    /**
+     * \brief start the counter, safe to call more than once
+     */
+    static void enable() {
+#ifndef HWLIB_HOST
+        // DEMCR.TRCENA powers the DWT, DWT_CTRL.CYCCNTENA starts the counter
+        *reinterpret_cast<volatile uint32_t *>(0xE000EDFC) |= 1u << 24;
+        *reinterpret_cast<volatile uint32_t *>(0xE0001000) |= 1u;
+#endif
+    }
+
+    /**
+     * \brief current value of the counter
+     */
+    static uint32_t now() {
+#ifdef HWLIB_HOST
+        return (uint32_t) hwlib::host::active_board().now_ns();
+#else
+        return *reinterpret_cast<volatile uint32_t *>(0xE0001004);    // DWT_CYCCNT
+#endif
+    }
+};
+
+#endif //RCCAR_CYCLECOUNTER_HPP
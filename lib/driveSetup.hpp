@@ -0,0 +1,140 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_DRIVESETUP_HPP
+#define RCCAR_DRIVESETUP_HPP
+
+#include "staticDrive.hpp"
+#include "speedSensor.hpp"
+#include "speedController.hpp"
+#include "auxOutputs.hpp"
+#include "commandPredictor.hpp"
+#include "responseCurve.hpp"
+#include "stickRamp.hpp"
+
+// The configuration of the car and of the remote that drives it: pins, ranges, gains and rates.
+// mainCar.cpp and mainRemote.cpp build carDrive and remoteDrive from it, and the host programs
+// that run the same drive path, like host/vehiclesim, include it too.
+namespace driveSetup {
+
+// every car on the band needs its own address, the remote that drives it uses the same one
+const uint8_t CAR_ADDRESS = 1;
+
+// ---- the car ----
+
+//Servo min and max values;
+constexpr uint16_t USMIN = 500;
+constexpr uint16_t USMAX = 2500;
+constexpr int16_t rangeMin = -512;
+constexpr int16_t rangeMax = 511;
+
+constexpr uint8_t FORWARDDIRPIN    = 3;
+constexpr uint8_t BACKWARDDIRPIN    = 2;
+constexpr uint8_t PWMPIN    = 1;
+constexpr uint8_t SERVOPIN  = 0;
+
+// Motordriver controller, configured at compile time, see staticDrive.hpp
+using motorDriver = staticIBT_2<PWMPIN, FORWARDDIRPIN, BACKWARDDIRPIN>;
+
+// Servodriver controller
+using steeringServo = staticServo<SERVOPIN, rangeMin, rangeMax, USMIN, USMAX>;
+
+// closed loop speed control, a hall sensor with 4 magnets on the driveshaft gives 8 counts per turn.
+// full throttle is MAX_SPEED counts per second, which leaves room to keep up with a low battery or a hill.
+// the gains come from host/motorsim, run it again after changing the sensor, the motor or the gearing
+using speedLoop = speedControl<tachometer, motorDriver>;
+const int32_t MAX_SPEED = 240;
+const uint32_t CONTROL_PERIOD_US = 20000;
+constexpr pidGains speedGains = { 10240, 512, 0, 3840, 100, 1024 };
+
+// aux outputs on the spare pins, in the order of the aux fields of the remote
+constexpr auxChannel auxChannels[] = {
+    { 4, auxType::SWITCH },                     // lights
+    { 5, auxType::SERVO, false, USMIN, USMAX }, // second steering servo
+    { 6, auxType::SERVO, false, 1000, 2000 },   // gearbox servo
+};
+constexpr uint8_t AUX_CHANNELS = sizeof(auxChannels) / sizeof(auxChannels[0]);
+
+static_assert(pinsDisjoint<motorDriver, steeringServo>() && !(auxPins(auxChannels) & (motorDriver::PINS | steeringServo::PINS)),
+              "two outputs on one PCA9685 pin");
+
+// the pulsed pins switch on at different moments in the period, so their currents do not add up.
+// the direction pins and the aux switches are fully on or off, they are left out
+constexpr uint16_t STAGGERED_PINS = (1u << PWMPIN) | steeringServo::PINS | pulsedAuxPins(auxChannels);
+
+// frames that do not change a pin cost no bus time. the steering ignores changes of up to 2 ticks,
+// about 10us, which is the noise of the stick. the motor ignores changes of the speed controller of up to 0.2%
+constexpr uint8_t SERVO_DEADBAND = 2;
+constexpr uint8_t MOTOR_DEADBAND = 8;
+
+// aux values wait for the next servo or motor write so they share its i2c transaction,
+// but no longer than this
+const uint32_t AUX_HOLD_US = 50000;
+
+// frames bring a command every 30ms or more, the steering and the speed target are updated every
+// OUTPUT_PERIOD_US in between, on the line through the last two commands. a command is about a frame
+// old when it is decoded, the look-ahead makes up for part of that. without frames the last command is held
+const uint32_t OUTPUT_PERIOD_US = 10000;
+constexpr predictorSettings commandPrediction = { 15000, 30000, 100000 };
+
+// the PCA9685 sleeps once the car has stood still this long without a frame that changed anything,
+// unless the lights are on. the next pin write wakes it, see PCA9685_i2c::wakeup().
+// asleep all outputs are off, so the brake is released and the servos are not held. the price:
+// a car parked on a slope rolls until the first count of the speed sensor, then carDrive wakes
+// the chip and the brake is back
+const uint32_t STANDSTILL_SLEEP_US = 10000000;
+
+// ---- the remote ----
+
+// every logical channel gets its own update rate, a frame takes about 30ms on air.
+// steering is sent as often as the link allows, throttle at most every other frame,
+// both are refreshed twice a second so a lost frame does not leave the car at an old value.
+// the rates adapt to the stick: a move of 128 of the 4096 steps or more goes out at the highest
+// rate, smaller moves wait longer, a held stick only sends the refresh.
+// the lights travel in aux frames, which only go out when no drive values are due
+enum channel : uint8_t { STEERING, THROTTLE, LIGHTS, CHANNELS };
+enum group : uint8_t { DRIVE, AUX };
+const uint32_t STEERING_INTERVAL_US = 30000;
+const uint32_t THROTTLE_INTERVAL_US = 60000;
+const uint32_t LIGHTS_INTERVAL_US = 100000;
+const uint32_t DRIVE_REFRESH_US = 500000;
+const uint32_t LIGHTS_REFRESH_US = 2000000;
+const uint16_t FULL_RATE_DELTA = 128;
+
+// an idle remote sends the drive values as a beacon every IDLE_BEACON_US instead of the refresh
+const uint32_t IDLE_BEACON_US = 2000000;
+
+// aux field 0 switches the lights of the car
+const uint8_t AUX_LIGHTS = 0;
+static_assert(auxChannels[AUX_LIGHTS].type == auxType::SWITCH, "the lights are switched on and off");
+
+// the stick is sampled every SAMPLE_PERIOD_US, also while a frame is on air: the transmitter
+// polls the sampler between its edges. Y is averaged over 100ms and X over 40ms
+const uint32_t SAMPLE_PERIOD_US = 2000;
+const uint16_t X_WINDOW = 20;
+const uint16_t Y_WINDOW = 50;
+
+// the throttle and the steering follow the stick in ramps, see stickRamp.hpp.
+// host/vehiclesim shows what the steps and the windows of the sampler do to the car
+constexpr rampSettings ramps;
+
+// response curves between the filtered stick and the frame, the tables are made at compile time.
+// holding the joystick down switches to the next profile
+constexpr curvePoint gentleThrottle[] = { { 0, 0 }, { 2048, 600 }, { 3072, 1400 }, { 4095, 2600 } };
+constexpr curveProfile profiles[] = {
+    { expoCurve(0), expoCurve(0) },                         // straight, what the stick says
+    { expoCurve(30), expoCurve(50) },                       // sport, soft around the center, full rates
+    { piecewiseCurve(gentleThrottle), expoCurve(40, 60) },  // beginner, slow and less steering
+};
+static_assert(monotonic(profiles[2].throttle), "the beginner throttle has to go up");
+constexpr uint8_t PROFILES = sizeof(profiles) / sizeof(profiles[0]);
+
+} // namespace driveSetup
+
+#endif //RCCAR_DRIVESETUP_HPP
@@ -0,0 +1,144 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_FRAMESCHEMA_HPP
+#define RCCAR_FRAMESCHEMA_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <type_traits>
+
+/**
+ * \struct field. one field of a frameSchema
+ *
+ * @tparam NAME any type, only used to find the field back, an empty struct will do
+ * @tparam WIDTH number of bits of the field
+ */
+template<typename NAME, unsigned WIDTH>
+struct field {
+    static_assert(WIDTH > 0 && WIDTH <= 32, "a field is 1 to 32 bits wide");
+    using name = NAME;
+    static constexpr unsigned width = WIDTH;
+};
+
+/**
+ * \class frameSchema. compile time description of a frame, from which packing and unpacking follow
+ * the first field is the most significant, the frame is sent most significant byte first.
+ * all functions are constexpr and resolve to a shift and a mask, so both sides of the link
+ * use the same layout without any run time cost. using a field that is not in the frame, or
+ * is in it twice, does not compile.
+ *
+ * @tparam FIELDS the fields of the frame, in the order they are sent
+ */
+template<typename... FIELDS>
+class frameSchema {
+public:
+    /**
+     * \brief total number of bits in the frame
+     */
+    static constexpr unsigned BITS = (FIELDS::width + ...);
+
+    /**
+     * \brief number of bytes the frame takes, the frame is left aligned in them
+     */
+    static constexpr size_t BYTES = (BITS + 7) / 8;
+
+    static_assert(BITS <= 32, "a frame has to fit in 32 bits");
+
+private:
+    static constexpr size_t FIELD_COUNT = sizeof...(FIELDS);
+    static constexpr unsigned widths[FIELD_COUNT] = { FIELDS::width... };
+
+    template<typename NAME>
+    static constexpr size_t occurrences() {
+        return ((std::is_same<NAME, typename FIELDS::name>::value ? 1 : 0) + ...);
+    }
+
+    template<typename NAME>
+    static constexpr size_t indexOf() {
+        constexpr bool matches[FIELD_COUNT] = { std::is_same<NAME, typename FIELDS::name>::value... };
+        for (size_t i = 0; i < FIELD_COUNT; i++) {
+            if (matches[i]) {
+                return i;
+            }
+        }
+        return FIELD_COUNT;
+    }
+
+public:
+    /**
+     * \brief number of bits of a field
+     */
+    template<typename NAME>
+    static constexpr unsigned width() {
+        static_assert(occurrences<NAME>() == 1, "the field has to be in the frame exactly once");
+        return widths[indexOf<NAME>()];
+    }
+
+    /**
+     * \brief position of the least significant bit of a field
+     */
+    template<typename NAME>
+    static constexpr unsigned shift() {
+        static_assert(occurrences<NAME>() == 1, "the field has to be in the frame exactly once");
+        unsigned s = 0;
+        for (size_t i = indexOf<NAME>() + 1; i < FIELD_COUNT; i++) {
+            s += widths[i];
+        }
+        return s;
+    }
+
+    /**
+     * \brief the bits of a field, not yet shifted into place
+     */
+    template<typename NAME>
+    static constexpr uint32_t mask() {
+        return width<NAME>() == 32 ? 0xFFFFFFFFu : (1u << width<NAME>()) - 1;
+    }
+
+    /**
+     * \brief a value moved into the place of its field, or the results together for a whole frame
+     * bits of the value that do not fit in the field are dropped
+     */
+    template<typename NAME>
+    static constexpr uint32_t pack(uint32_t value) {
+        return (value & mask<NAME>()) << shift<NAME>();
+    }
+
+    /**
+     * \brief the value of a field taken out of a frame
+     */
+    template<typename NAME>
+    static constexpr uint32_t unpack(uint32_t frame) {
+        return (frame >> shift<NAME>()) & mask<NAME>();
+    }
+
+    /**
+     * \brief split a frame in BYTES bytes, most significant first
+     */
+    static constexpr void toBytes(uint32_t frame, uint8_t * bytes) {
+        uint32_t aligned = frame << (BYTES * 8 - BITS);
+        for (size_t i = 0; i < BYTES; i++) {
+            bytes[i] = aligned >> (8 * (BYTES - 1 - i));
+        }
+    }
+
+    /**
+     * \brief put a frame back together from BYTES bytes, most significant first
+     */
+    static constexpr uint32_t fromBytes(const uint8_t * bytes) {
+        uint32_t aligned = 0;
+        for (size_t i = 0; i < BYTES; i++) {
+            aligned = (aligned << 8) | bytes[i];
+        }
+        return aligned >> (BYTES * 8 - BITS);
+    }
+};
+
+#endif //RCCAR_FRAMESCHEMA_HPP
@@ -0,0 +1,99 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_IDLESLEEP_HPP
+#define RCCAR_IDLESLEEP_HPP
+
+#include <hwlib.hpp>
+
+/**
+ * \class idleSleep. waits with the core stopped instead of spinning in hwlib::wait_us
+ * on the target, timer counter TC0 channel 0 counts up to the end of the wait at MCK/128 and
+ * stops, its compare interrupt wakes the core from WFI. interrupts are masked around the WFI,
+ * so the interrupt only wakes the core and is cleared here, no handler is needed.
+ * hwlib keeps its time by polling the 24 bit SysTick, which wraps every 200ms, so a single
+ * sleep is cut into pieces of at most MAX_PIECE_US.
+ * on the host it is hwlib::wait_us, the time slept is counted on both.
+ */
+class idleSleep {
+private:
+    uint_fast64_t total = 0;
+
+#ifndef HWLIB_HOST
+    static volatile uint32_t & reg(uint32_t address) {
+        return *reinterpret_cast<volatile uint32_t *>(address);
+    }
+
+    static constexpr uint32_t PMC_PCER0 = 0x400E0610;
+    static constexpr uint32_t TC0_CCR   = 0x40080000;
+    static constexpr uint32_t TC0_CMR   = 0x40080004;
+    static constexpr uint32_t TC0_RC    = 0x4008001C;
+    static constexpr uint32_t TC0_SR    = 0x40080020;
+    static constexpr uint32_t TC0_IER   = 0x40080024;
+    static constexpr uint32_t NVIC_ISER0 = 0xE000E100;
+    static constexpr uint32_t NVIC_ISPR0 = 0xE000E200;
+    static constexpr uint32_t NVIC_ICPR0 = 0xE000E280;
+    static constexpr uint32_t TC0_ID    = 27;           /**< peripheral and interrupt number of TC0 */
+
+    void piece(uint32_t us) {
+        // MCK/128 is 656.25kHz, 21/32 tick per us
+        reg(TC0_RC) = (us * 21 >> 5) + 1;
+        asm volatile ("cpsid i" ::: "memory");
+        reg(TC0_CCR) = 0x5;                     // CLKEN and SWTRG, starts from 0
+        do {
+            asm volatile ("wfi" ::: "memory");
+        } while (!(reg(NVIC_ISPR0) & (1u << TC0_ID)));
+        (void) reg(TC0_SR);                     // clears CPCS
+        reg(NVIC_ICPR0) = 1u << TC0_ID;
+        asm volatile ("cpsie i" ::: "memory");
+    }
+#endif
+
+public:
+    static constexpr uint32_t MAX_PIECE_US = 100000;
+
+    /**
+     * \brief Standard constructor, sets up the timer
+     */
+    idleSleep() {
+#ifndef HWLIB_HOST
+        reg(PMC_PCER0) = 1u << TC0_ID;
+        // TIMER_CLOCK4 (MCK/128), CPCSTOP, WAVSEL UP_RC, WAVE
+        reg(TC0_CMR) = 0x3 | (1u << 6) | (2u << 13) | (1u << 15);
+        reg(TC0_IER) = 1u << 4;                 // CPCS
+        reg(NVIC_ISER0) = 1u << TC0_ID;
+#endif
+    }
+
+    /**
+     * \brief sleep for a while, interrupts that come in meanwhile are served at the end of the piece
+     *
+     * @param us time to sleep in us
+     */
+    void sleep_us(uint32_t us) {
+        total += us;
+#ifdef HWLIB_HOST
+        hwlib::wait_us(us);
+#else
+        uint_fast64_t end = hwlib::now_us() + us;
+        for (uint_fast64_t now = hwlib::now_us(); now < end; now = hwlib::now_us()) {
+            piece(end - now > MAX_PIECE_US ? MAX_PIECE_US : end - now);
+        }
+#endif
+    }
+
+    /**
+     * \brief total time passed to sleep_us, in us
+     */
+    uint_fast64_t slept() const {
+        return total;
+    }
+};
+
+#endif //RCCAR_IDLESLEEP_HPP
@@ -10,13 +10,87 @@
 #ifndef IPASS_INPUT_H
 #define IPASS_INPUT_H
 
+#include <stdint.h>
+
 /**
- *  \class inputController class. This abstract class allows for more types of controllers to be implemented later on
+ * \struct inputSnapshot. all axes and buttons of an input device, read at one moment
+ * the axes are 12 bit like the adc, 0 to 4095, a stick is centered at 2048.
+ * bit n of buttons is set while button n is pressed.
  */
+template<uint8_t N>
+struct inputSnapshot {
+    uint_fast64_t us = 0;       /**< time of the reading */
+    uint16_t axis[N] = {};
+    uint32_t buttons = 0;
+
+    constexpr bool pressed(uint8_t button) const {
+        return buttons & (1u << button);
+    }
+};
+
+/**
+ *  \class inputController. an input device with N axes and BUTTONS buttons, at most 32.
+ *  read() returns everything in one snapshot, with the time it was read.
+ *  code that polls a device in its loop, like stickSampler, takes the type of the device as a template
+ *  parameter instead of this base class: the devices are final, so those calls are direct and can be inlined.
+ *  code that runs now and then can hold any device as an inputController.
+ */
+template<uint8_t N, uint8_t BUTTONS = 0>
 class inputController {
+    static_assert(N > 0 && BUTTONS <= 32, "an input needs an axis and has at most 32 buttons");
+
+public:
+    static constexpr uint8_t AXES = N;
+    static constexpr uint8_t BUTTON_COUNT = BUTTONS;
+    using snapshot = inputSnapshot<N>;
+
+    /**
+     * \brief read all axes and buttons
+     */
+    virtual snapshot read() = 0;
+};
+
+/**
+ * \class inputPair. two devices read as one, the axes and buttons of the second follow those of the first.
+ * a pistol grip is a trigger and a wheel, a dual stick two joysticks
+ */
+template<class FIRST, class SECOND>
+class inputPair final : public inputController<FIRST::AXES + SECOND::AXES, FIRST::BUTTON_COUNT + SECOND::BUTTON_COUNT> {
+private:
+    FIRST & first;
+    SECOND & second;
+
+public:
+    using snapshot = inputSnapshot<FIRST::AXES + SECOND::AXES>;
+
+    /**
+     * \brief Standard constructor
+     *
+     * @param first the device with the lower axes and buttons
+     * @param second the device after it
+     */
+    inputPair(FIRST & first, SECOND & second):
+        first(first),
+        second(second)
+    {}
 
-    virtual uint16_t readX() = 0;
-    virtual uint16_t readY() = 0;
+    /**
+     * \brief read both devices, the snapshot has the time of the first
+     */
+    snapshot read() override {
+        auto a = first.read();
+        auto b = second.read();
+        snapshot s;
+        s.us = a.us;
+        for (uint8_t i = 0; i < FIRST::AXES; i++) {
+            s.axis[i] = a.axis[i];
+        }
+        for (uint8_t i = 0; i < SECOND::AXES; i++) {
+            s.axis[FIRST::AXES + i] = b.axis[i];
+        }
+        s.buttons = FIRST::BUTTON_COUNT < 32 ? a.buttons | (b.buttons << (FIRST::BUTTON_COUNT % 32)) : a.buttons;
+        return s;
+    }
 };
 
 #endif //IPASS_INPUT_H
@@ -32,7 +32,19 @@ uint16_t joystickController::readY() {
     return yCoor;
 }
 
+joystickController::snapshot joystickController::read() {
+    snapshot s;
+    s.us = hwlib::now_us();
+    checkJoystick();
+    s.axis[X_AXIS] = xCoor;
+    s.axis[Y_AXIS] = yCoor;
+    // the pull up keeps the pin high while the button is not pressed
+    s.buttons = click.read() ? 0 : 1u << CLICK;
+    return s;
+}
+
 void joystickController::checkJoystick() {
     xCoor = X.read();
     yCoor = Y.read();
+    RCCAR_TRACE_POINT(tracePoint::ADC_SAMPLE, yCoor);
 }
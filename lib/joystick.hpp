@@ -12,12 +12,17 @@
 
 #include <hwlib.hpp>
 #include "inputController.hpp"
+#include "latencyTrace.hpp"
 
 /**
  *  \class joystickController.
- *  this class implements abstract class inputController so that readX and ReadY are always implemented.
+ *  an analog joystick with a click button, two axes and one button for inputController.
  */
-class joystickController: public inputController {
+class joystickController final : public inputController<2, 1> {
+public:
+    enum axes : uint8_t { X_AXIS, Y_AXIS };
+    enum buttons : uint8_t { CLICK };
+
 private:
     hwlib::pin_in &click;
     hwlib::adc &X;
@@ -51,13 +56,55 @@ public:
      * \brief returns value of current X axis
      * @return the current value of X
      */
-    uint16_t readX() override;
+    uint16_t readX();
 
     /**
      * \brief return value of current Y axis
      * @return the current value of Y
      */
-    uint16_t readY() override;
+    uint16_t readY();
+
+    /**
+     * \brief reads both axes once and the button, the button is set while it is pressed
+     */
+    snapshot read() override;
+};
+
+/**
+ * \brief two joysticks as one input: X_AXIS and Y_AXIS of the first, then of the second,
+ * button 0 is the click of the first and button 1 that of the second
+ */
+using dualStickController = inputPair<joystickController, joystickController>;
+
+/**
+ *  \class triggerController.
+ *  the trigger of a pistol grip remote, one axis on an adc and no buttons.
+ *  a trigger that is wired the other way round is read inverted, so pulling it always goes up
+ */
+class triggerController final : public inputController<1> {
+private:
+    hwlib::adc & travel;
+    bool inverted;
+
+public:
+    /**
+     * \brief Standard constructor
+     *
+     * @param travel analog to digital pin the trigger is on
+     * @param inverted whether pulling the trigger lowers the adc value
+     */
+    triggerController(hwlib::adc & travel, bool inverted = false):
+        travel(travel),
+        inverted(inverted)
+    {}
+
+    snapshot read() override {
+        snapshot s;
+        s.us = hwlib::now_us();
+        uint16_t value = travel.read();
+        s.axis[0] = inverted ? 4095 - value : value;
+        return s;
+    }
 };
 
 #endif //IPASS_JOYSTICK_HPP
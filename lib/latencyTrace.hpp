@@ -0,0 +1,112 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_LATENCYTRACE_HPP
+#define RCCAR_LATENCYTRACE_HPP
+
+#include <hwlib.hpp>
+#include "cycleCounter.hpp"
+
+/**
+ * \brief the points along the path from the stick to the wheels that can be traced
+ */
+enum class tracePoint : uint8_t {
+    ADC_SAMPLE,         /**< joystickController read the adc's, value is Y */
+    FRAME_ENCODED,      /**< constructMessage packed a frame, value is its checksum */
+    FIRST_EDGE,         /**< Receiver433mhz saw the first pulse of a frame */
+    FRAME_DECODED,      /**< Receiver433mhz unpacked a frame, value is its checksum */
+    PCA_WRITE           /**< PCA9685_i2c::setPWM, value is the pin in the top 4 bits and off in the lower 12 */
+};
+
+// The trace points are only compiled in when RCCAR_TRACE is defined, for
+// instance with `make TRACE=1` in host/. Without it every RCCAR_TRACE_POINT
+// is an empty statement and none of the code below exists.
+#ifdef RCCAR_TRACE
+
+#ifndef RCCAR_TRACE_SIZE
+#define RCCAR_TRACE_SIZE 256
+#endif
+
+/**
+ * \class latencyTrace. fixed ring buffer of trace points timestamped with the cycleCounter
+ */
+class latencyTrace {
+public:
+    /**
+     * \struct record. one trace point as it is stored in the buffer
+     */
+    struct record {
+        uint32_t cycles;
+        uint16_t value;
+        tracePoint point;
+    };
+
+    /**
+     * \brief store a trace point, the oldest record is overwritten when the buffer is full
+     *
+     * @param point which point was passed
+     * @param value something to identify the event by, see tracePoint
+     */
+    static void mark(tracePoint point, uint16_t value) {
+        auto & t = instance();
+        t.records[t.next] = record{ cycleCounter::now(), value, point };
+        t.next = (t.next + 1) % RCCAR_TRACE_SIZE;
+        if (t.count < RCCAR_TRACE_SIZE) {
+            t.count++;
+        }
+    }
+
+    /**
+     * \brief whether the buffer has been filled completely
+     */
+    static bool full() {
+        return instance().count == RCCAR_TRACE_SIZE;
+    }
+
+    /**
+     * \brief write all records, oldest first, to hwlib::cout and empty the buffer
+     * one line per record: "trace <point> <cycles> <value>", preceded by a line with the cycles per us
+     */
+    static void dump() {
+        auto & t = instance();
+        hwlib::cout << "trace-cycles-per-us " << cycleCounter::CYCLES_PER_US << hwlib::endl;
+        size_t first = (t.next + RCCAR_TRACE_SIZE - t.count) % RCCAR_TRACE_SIZE;
+        for (size_t i = 0; i < t.count; i++) {
+            auto & r = t.records[(first + i) % RCCAR_TRACE_SIZE];
+            hwlib::cout << "trace " << (int) r.point << " " << r.cycles << " " << r.value << hwlib::endl;
+        }
+        t.count = 0;
+    }
+
+private:
+    record records[RCCAR_TRACE_SIZE];
+    size_t next = 0;
+    size_t count = 0;
+
+    latencyTrace() {
+        cycleCounter::enable();
+    }
+
+    static latencyTrace & instance() {
+        static latencyTrace t;
+        return t;
+    }
+};
+
+#define RCCAR_TRACE_POINT(point, value) latencyTrace::mark(point, value)
+#define RCCAR_TRACE_DUMP_WHEN_FULL() do { if (latencyTrace::full()) { latencyTrace::dump(); } } while (0)
+
+#else
+
+#define RCCAR_TRACE_POINT(point, value) ((void) 0)
+#define RCCAR_TRACE_DUMP_WHEN_FULL() ((void) 0)
+
+#endif //RCCAR_TRACE
+
+#endif //RCCAR_LATENCYTRACE_HPP
@@ -0,0 +1,179 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_LINKFRAMES_HPP
+#define RCCAR_LINKFRAMES_HPP
+
+#include "frameSchema.hpp"
+
+// The frames of the 433mhz link. On air every frame is an address byte followed
+// by one of the layouts below. constructMessage packs them and Receiver433mhz
+// unpacks them, both from these definitions only.
+namespace linkFrames {
+
+// field names
+struct marker {};       /**< 1 for a drive frame, 0 for an aux frame */
+struct motorDir {};
+struct y {};
+struct x {};
+struct servoDir {};
+struct auxIndex {};
+struct auxValue {};
+struct unused {};       /**< always 0, a receiver rejects frames where it is not */
+struct checksum {};
+
+using driveFrame = frameSchema<
+    field<marker, 1>,
+    field<motorDir, 1>,
+    field<y, 10>,
+    field<x, 9>,
+    field<servoDir, 1>,
+    field<checksum, 10>
+>;
+
+using auxFrame = frameSchema<
+    field<marker, 1>,
+    field<auxIndex, 4>,
+    field<auxValue, 12>,
+    field<unused, 5>,
+    field<checksum, 10>
+>;
+
+static_assert(driveFrame::BITS == 32, "the receiver expects 32 bits after the address");
+static_assert(auxFrame::BITS == 32, "aux frames are as long as drive frames");
+static_assert(driveFrame::shift<marker>() == auxFrame::shift<marker>() && driveFrame::width<marker>() == 1,
+              "the marker tells the frames apart, it has to be in the same place");
+
+/**
+ * \brief number of bytes on air, the address and the frame
+ */
+constexpr size_t FRAME_BYTES = 1 + driveFrame::BYTES;
+
+/**
+ * \brief the kind of frame, read from the marker
+ */
+constexpr bool isDrive(uint32_t frame) {
+    return driveFrame::unpack<marker>(frame);
+}
+
+/**
+ * \brief checksum of a drive frame, over every field and the address, so a bit error in the address
+ * does not hand the frame to another car and a bit error in the motor direction does not reverse it.
+ * the motor direction goes in at bit MOTOR_DIR_BIT, away from the bits of the fields next to it on air
+ */
+constexpr uint8_t MOTOR_DIR_BIT = 0;
+constexpr uint16_t driveChecksum(bool motorDirection, uint16_t Y, uint16_t X, bool servoDirection, uint8_t address) {
+    return (Y ^ (((X << 1) | servoDirection) ^ address) ^ ((uint16_t) motorDirection << MOTOR_DIR_BIT))
+           & driveFrame::mask<checksum>();
+}
+
+/**
+ * \brief checksum of an aux frame, over the index, the value and the address
+ */
+constexpr uint16_t auxChecksum(uint8_t index, uint16_t value, uint8_t address) {
+    return ((value & 0x3FF) ^ (((index << 2) | (value >> 10)) ^ address)) & auxFrame::mask<checksum>();
+}
+
+/**
+ * \brief a complete drive frame
+ */
+constexpr uint32_t packDrive(bool motorDirection, uint16_t Y, uint16_t X, bool servoDirection, uint8_t address) {
+    return driveFrame::pack<marker>(1)
+         | driveFrame::pack<motorDir>(motorDirection)
+         | driveFrame::pack<y>(Y)
+         | driveFrame::pack<x>(X)
+         | driveFrame::pack<servoDir>(servoDirection)
+         | driveFrame::pack<checksum>(driveChecksum(motorDirection, Y, X, servoDirection, address));
+}
+
+/**
+ * \brief a complete aux frame
+ */
+constexpr uint32_t packAux(uint8_t index, uint16_t value, uint8_t address) {
+    return auxFrame::pack<marker>(0)
+         | auxFrame::pack<auxIndex>(index)
+         | auxFrame::pack<auxValue>(value)
+         | auxFrame::pack<checksum>(auxChecksum(index, value, address));
+}
+
+/**
+ * \brief whether a received drive frame is intact
+ */
+constexpr bool driveValid(uint32_t frame, uint8_t address) {
+    return isDrive(frame) && driveFrame::unpack<checksum>(frame)
+        == driveChecksum(driveFrame::unpack<motorDir>(frame), driveFrame::unpack<y>(frame), driveFrame::unpack<x>(frame),
+                         driveFrame::unpack<servoDir>(frame), address);
+}
+
+/**
+ * \brief whether a received aux frame is intact
+ */
+constexpr bool auxValid(uint32_t frame, uint8_t address) {
+    return !isDrive(frame) && auxFrame::unpack<unused>(frame) == 0 && auxFrame::unpack<checksum>(frame)
+        == auxChecksum(auxFrame::unpack<auxIndex>(frame), auxFrame::unpack<auxValue>(frame), address);
+}
+
+// The round trip through bytes is checked by the compiler for every value of every
+// field, the other fields held at a value with alternating bits, and the layout is
+// pinned by two known frames.
+namespace check {
+
+constexpr uint32_t throughBytes(uint32_t frame) {
+    uint8_t bytes[driveFrame::BYTES] = {};
+    driveFrame::toBytes(frame, bytes);
+    return driveFrame::fromBytes(bytes);
+}
+
+constexpr bool driveRoundTrip(bool m, uint16_t Y, uint16_t X, bool s) {
+    uint32_t frame = throughBytes(packDrive(m, Y, X, s, 1));
+    return driveValid(frame, 1) && !driveValid(frame, 2) && !auxValid(frame, 1)
+        && !driveValid(frame ^ driveFrame::pack<motorDir>(1), 1)
+        && driveFrame::unpack<y>(frame) == Y && driveFrame::unpack<x>(frame) == X
+        && driveFrame::unpack<motorDir>(frame) == m && driveFrame::unpack<servoDir>(frame) == s;
+}
+
+constexpr bool auxRoundTrip(uint8_t index, uint16_t value) {
+    uint32_t frame = throughBytes(packAux(index, value, 1));
+    return auxValid(frame, 1) && !auxValid(frame, 2) && !driveValid(frame, 1)
+        && auxFrame::unpack<auxIndex>(frame) == index && auxFrame::unpack<auxValue>(frame) == value;
+}
+
+constexpr bool everyDriveValue() {
+    for (uint16_t Y = 0; Y < 1024; Y++) {
+        if (!driveRoundTrip(Y & 1, Y, 0x155, Y & 2)) {
+            return false;
+        }
+    }
+    for (uint16_t X = 0; X < 512; X++) {
+        if (!driveRoundTrip(X & 2, 0x2AA, X, X & 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr bool everyAuxValue() {
+    for (uint16_t value = 0; value < 4096; value++) {
+        if (!auxRoundTrip(value & 0x0F, value)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(packDrive(true, 0x1D3, 0x0A2, false, 1) == 0xDD351097u, "drive layout changed");
+static_assert(packAux(2, 0xABC, 1) == 0x155E02B7u, "aux layout changed");
+static_assert(everyDriveValue(), "drive frames do not survive packing and unpacking");
+static_assert(everyAuxValue(), "aux frames do not survive packing and unpacking");
+
+} // namespace check
+
+} // namespace linkFrames
+
+#endif //RCCAR_LINKFRAMES_HPP
@@ -0,0 +1,220 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_LOOPPROFILER_HPP
+#define RCCAR_LOOPPROFILER_HPP
+
+#include <hwlib.hpp>
+#include "cycleCounter.hpp"
+
+/**
+ * \class cycleProfiler. measures how long each iteration of a main loop takes and where the time goes
+ * call iteration() at the top of the loop and section() whenever the loop moves on to another part.
+ * durations are kept in a histogram with four buckets per power of two, from which the p99 is taken.
+ * all arithmetic is integer, the Due has no FPU.
+ *
+ * @tparam SECTIONS number of named sections the loop is divided in
+ */
+template<size_t SECTIONS>
+class cycleProfiler {
+private:
+    static constexpr size_t BUCKETS = 124;
+
+    const char * const * names;         /**< name of every section, for the report */
+    uint32_t reportInterval;            /**< cycles between two reports */
+
+    uint32_t iterationStart = 0;
+    uint32_t sectionStart = 0;
+    uint32_t lastReport = 0;
+    uint8_t current = 0;
+    bool running = false;
+
+    uint32_t iterations = 0;
+    uint64_t total = 0;
+    uint32_t longest = 0;
+    uint32_t histogram[BUCKETS] = {0};
+
+    uint32_t sectionThisIteration[SECTIONS] = {0};
+    uint64_t sectionTotal[SECTIONS] = {0};
+    uint32_t sectionLongest[SECTIONS] = {0};
+
+    static size_t bucket(uint32_t cycles) {
+        if (cycles < 4) {
+            return cycles;
+        }
+        uint32_t msb = 31 - __builtin_clz(cycles);
+        return 4 * (msb - 1) + ((cycles >> (msb - 2)) & 3);
+    }
+
+    static uint32_t bucketEnd(size_t index) {
+        if (index < 4) {
+            return index;
+        }
+        uint32_t msb = index / 4 + 1;
+        uint32_t low = (uint32_t) (4 + index % 4) << (msb - 2);
+        return low + ((1u << (msb - 2)) - 1);
+    }
+
+    static void printUs(uint64_t cycles) {
+        uint64_t tenths = cycles * 10 / cycleCounter::CYCLES_PER_US;
+        hwlib::cout << (uint32_t) (tenths / 10) << "." << (uint32_t) (tenths % 10) << " us";
+    }
+
+    void closeSection(uint32_t now) {
+        sectionThisIteration[current] += now - sectionStart;
+        sectionStart = now;
+    }
+
+public:
+    /**
+     * \brief Standard constructor
+     *
+     * @param names array of SECTIONS section names
+     * @param reportIntervalMs how often iteration() asks for a report, in milliseconds.
+     * limited to half a wrap of the cycleCounter, 25 s on the target and 2 s on the host
+     */
+    cycleProfiler(const char * const * names, uint32_t reportIntervalMs = 5000):
+        names(names),
+        reportInterval((uint64_t) reportIntervalMs * 1000 * cycleCounter::CYCLES_PER_US < 0x80000000u
+                       ? reportIntervalMs * 1000 * cycleCounter::CYCLES_PER_US : 0x7FFFFFFFu)
+    {
+        cycleCounter::enable();
+    }
+
+    /**
+     * \brief call at the top of every loop iteration, closes the previous iteration
+     * @return true when it is time to call report()
+     */
+    bool iteration() {
+        uint32_t now = cycleCounter::now();
+        if (running) {
+            closeSection(now);
+            uint32_t duration = now - iterationStart;
+            iterations++;
+            total += duration;
+            if (duration > longest) {
+                longest = duration;
+            }
+            histogram[bucket(duration)]++;
+            for (size_t i = 0; i < SECTIONS; i++) {
+                sectionTotal[i] += sectionThisIteration[i];
+                if (sectionThisIteration[i] > sectionLongest[i]) {
+                    sectionLongest[i] = sectionThisIteration[i];
+                }
+                sectionThisIteration[i] = 0;
+            }
+        } else {
+            running = true;
+            lastReport = now;
+        }
+        iterationStart = now;
+        sectionStart = now;
+        current = 0;
+        return now - lastReport >= reportInterval;
+    }
+
+    /**
+     * \brief from now on, time is attributed to another section
+     * @param index the section, smaller than SECTIONS
+     */
+    void section(uint8_t index) {
+        closeSection(cycleCounter::now());
+        current = index;
+    }
+
+    /**
+     * \brief iteration with the highest duration so far, in cycles
+     */
+    uint32_t max() const {
+        return longest;
+    }
+
+    /**
+     * \brief duration under which 99% of the iterations stayed, in cycles, accurate to a quarter octave
+     */
+    uint32_t p99() const {
+        uint64_t needed = ((uint64_t) iterations * 99 + 99) / 100;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            seen += histogram[i];
+            if (seen >= needed && seen > 0) {
+                return bucketEnd(i) < longest ? bucketEnd(i) : longest;
+            }
+        }
+        return longest;
+    }
+
+    /**
+     * \brief write the statistics to hwlib::cout and start over
+     * the time spent printing is not counted as part of any iteration
+     */
+    void report() {
+        hwlib::cout << "loop " << iterations << " iterations, mean ";
+        printUs(iterations ? total / iterations : 0);
+        hwlib::cout << ", p99 ";
+        printUs(p99());
+        hwlib::cout << ", max ";
+        printUs(longest);
+        hwlib::cout << hwlib::endl;
+        for (size_t i = 0; i < SECTIONS; i++) {
+            hwlib::cout << "  " << names[i] << " " << (uint32_t) (total ? sectionTotal[i] * 100 / total : 0) << "%, mean ";
+            printUs(iterations ? sectionTotal[i] / iterations : 0);
+            hwlib::cout << ", max ";
+            printUs(sectionLongest[i]);
+            hwlib::cout << hwlib::endl;
+        }
+        for (size_t i = 0; i < BUCKETS; i++) {
+            if (histogram[i]) {
+                hwlib::cout << "  <= ";
+                printUs(bucketEnd(i));
+                hwlib::cout << " " << histogram[i] << hwlib::endl;
+            }
+        }
+
+        iterations = 0;
+        total = 0;
+        longest = 0;
+        for (auto & h : histogram) {
+            h = 0;
+        }
+        for (size_t i = 0; i < SECTIONS; i++) {
+            sectionTotal[i] = 0;
+            sectionLongest[i] = 0;
+            sectionThisIteration[i] = 0;
+        }
+        running = false;
+    }
+};
+
+/**
+ * \class disabledProfiler. same interface as cycleProfiler, but does nothing at all
+ */
+template<size_t SECTIONS>
+class disabledProfiler {
+public:
+    disabledProfiler(const char * const *, uint32_t = 0) {}
+    bool iteration() { return false; }
+    void section(uint8_t) {}
+    uint32_t max() const { return 0; }
+    uint32_t p99() const { return 0; }
+    void report() {}
+};
+
+// The mains always declare a loopProfiler. It only measures when RCCAR_PROFILE
+// is defined, for instance with `make PROFILE=1` in host/, otherwise every call
+// compiles to nothing.
+#ifdef RCCAR_PROFILE
+template<size_t SECTIONS>
+using loopProfiler = cycleProfiler<SECTIONS>;
+#else
+template<size_t SECTIONS>
+using loopProfiler = disabledProfiler<SECTIONS>;
+#endif
+
+#endif //RCCAR_LOOPPROFILER_HPP
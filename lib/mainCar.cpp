@@ -1,7 +1,10 @@
 #include "hwlib.hpp"
 #include "PCA9685.hpp"
-#include "motorController.hpp"
 #include "Receiver433mhz.hpp"
+#include "carDrive.hpp"
+#include "pulseCapture.hpp"
+#include "loopProfiler.hpp"
+#include "telemetry.hpp"
 
 int main() {
 
@@ -10,50 +13,95 @@ int main() {
 
     namespace target = hwlib::target;
 
+    // every car on the band needs its own address, see driveSetup.hpp
     auto receiverPin = target::pin_in(target::pins::d2);
-    auto receiver = Receiver433mhz(receiverPin);
+    auto receiver = Receiver433mhz(receiverPin, driveSetup::CAR_ADDRESS);
+
+#ifdef RCCAR_CAPTURE
+    // record the raw RF edges and dump them over serial once the link has been lost for a second,
+    // the dump can be replayed with host/replay. 4096 edges take 16 KB of RAM
+    static pulseCaptureBuffer<4096> capture;
+    receiver.setCapture(capture);
+    const uint32_t CAPTURE_DUMP_AFTER_US = 1000000;
+    uint_fast64_t lastFrame = 0;
+    bool captureDumped = true;
+#endif
 
     auto scl = target::pin_oc(target::pins::scl);
     auto sda = target::pin_oc(target::pins::sda);
     auto i2c_bus = hwlib::i2c_bus_bit_banged_scl_sda(scl, sda);
     auto PCA = PCA9685_i2c(i2c_bus);
 
-    //  Initialize the PCA9685 with the values for this project
-    PCA.begin();
-    PCA.setOscillatorFrequency(27000000);
-    PCA.setPWMFreq(50);
-    hwlib::wait_ms(10);
-    //Servo min and max values;
-    uint16_t USMIN = 500;
-    uint16_t USMAX = 2500;
-    int16_t rangeMin = -512;
-    int16_t rangeMax = 511;
-
-    const uint16_t FORWARDDIRPIN    = 3;
-    const uint16_t BACKWARDDIRPIN    = 2;
-    //const uint16_t DIRPIN    = 2;
-    const uint16_t PWMPIN    = 1;
-    const uint16_t SERVOPIN  = 0;
-
-    // Motordriver controller
-    //genericDriver motor( PCA, PWMPIN, DIRPIN);
-    IBT_2 motor( PCA, PWMPIN, FORWARDDIRPIN, BACKWARDDIRPIN);
+    // the motor, the speed controller, the steering servo and the aux outputs, as set up in driveSetup.hpp.
+    // the speed sensor is a hall sensor on the driveshaft
+    auto tachoPin = target::pin_in(target::pins::d3);
+    carDrive drive(receiver, PCA, tachoPin);
+    drive.begin();
 
-    // Servodriver controller
-    servo ser( PCA, SERVOPIN, rangeMin, rangeMax, USMIN, USMAX);
+    // loop profiler, only active when compiled with RCCAR_PROFILE
+    enum section : uint8_t { RECEIVE, ACTUATE, CONTROL };
+    const char * sectionNames[] = { "receive", "actuate", "control" };
+    loopProfiler<3> profiler(sectionNames);
 
+    // binary records of the loop, the link and the outputs, only sent when compiled with RCCAR_TELEMETRY.
+    // decode them with host/teledecode
+    telemetry<64> telemetryLog;
+    receiverStatistics reported;
+    uint32_t reportedWakes = 0;
 
     volatile bool _true = true;
     while (_true) {
+        if (telemetryLog.iteration()) {
+            const receiverStatistics & link = receiver.statistics();
+            telemetryLog.record(telemetryType::RX_LINK, link.accepted - reported.accepted,
+                                link.rejected - reported.rejected, link.damaged - reported.damaged);
+            reported = link;
+            const pca9685Statistics & pca = PCA.statistics();
+            if (pca.wakes != reportedWakes) {
+                telemetryLog.record(telemetryType::WAKE, pca.wakes > INT16_MAX ? INT16_MAX : pca.wakes,
+                                    pca.wakeLatencyUs > INT16_MAX ? INT16_MAX : pca.wakeLatencyUs);
+                reportedWakes = pca.wakes;
+            }
+        }
+
+        if (profiler.iteration()) {
+            profiler.report();
+#ifdef RCCAR_PROFILE
+            const pca9685Statistics & pca = PCA.statistics();
+            hwlib::cout << "pca " << pca.pinWrites << " pin writes, " << pca.suppressed << " suppressed, "
+                        << pca.transactions << " transactions, " << pca.bytes << " bytes" << hwlib::endl;
+            hwlib::cout << "pca " << pca.wakes << " wakes, wake to first output " << pca.wakeLatencyUs
+                        << " us, longest " << pca.wakeLatencyMaxUs << " us" << hwlib::endl;
+#endif
+        }
 
+        profiler.section(RECEIVE);
         receiver.messageLoop();
+        RCCAR_TRACE_DUMP_WHEN_FULL();
 
-        if (receiver.messageAvailable()){
+#ifdef RCCAR_CAPTURE
+        if (receiver.messageAvailable()) {
+            lastFrame = hwlib::now_us();
+            captureDumped = false;
+        } else if (!captureDumped && hwlib::now_us() - lastFrame > CAPTURE_DUMP_AFTER_US) {
+            capture.dump();
+            captureDumped = true;
+        }
+#endif
 
-            motor.setDirection(receiver.getMotorDir());
-            motor.setSpeed(receiver.getY()*4);
+        drive.receive();
 
-            ser.setPosition(ser.mapInverse(receiver.getX() * (receiver.getServoDir() == 0 ? -1 : 1)));
+        profiler.section(ACTUATE);
+        if (drive.actuate()) {
+            telemetryLog.record(telemetryType::STEERING, drive.steering(), drive.servoPulse());
         }
+
+        profiler.section(CONTROL);
+        if (drive.control()) {
+            const driveSetup::speedLoop & speed = drive.speedController();
+            telemetryLog.record(telemetryType::MOTOR, speed.getTarget(), speed.getMeasured(), speed.getOutput());
+        }
+
+        telemetryLog.drain();
     }
 }
\ No newline at end of file
@@ -1,7 +1,11 @@
 #include "hwlib.hpp"
 #include "joystick.hpp"
 #include "Transmit433mhzController.hpp"
-#include "MovingAverage.hpp"
+#include "stickSampler.hpp"
+#include "remoteDrive.hpp"
+#include "loopProfiler.hpp"
+#include "idleSleep.hpp"
+#include "telemetry.hpp"
 
 int main() {
 
@@ -16,161 +20,122 @@ int main() {
     auto Y = due::pin_adc(due::ad_pins::a1);
     joystickController joy(click, X, Y);
 
-    auto transmitter = target::pin_out(target::pins::d9);
-    constructMessage message(transmitter);
-
-    // Motordriver controller
-
-    uint16_t direction = true;              //true meaning forward, false meaning backwards
-
-    bool MotortimerRunning      = false;       // timer running
-    uint32_t timeBetweenStep     = 100;         // = versnellingsstap tijd (Time between each step update)
-    uint16_t Stepsize = 80;         // = volgende PWM waarde (Value of the increment per step)
-    uint16_t motorAcceleration = 0;           // = huidige snelheid (Current PWM value written to board)
-    int16_t targetSpeed = 0;       // = gewenste snelheid (Target PWM value as read from joystick)
-    int16_t previousSpeed = 0;         // staat stil (Previous value of acceleration)
-    int8_t  speedUp_slowDown = 1;   // 1 = versnellen -1 = vertragen 0 = idle
-    uint_fast64_t motortimer;                // variable that holds the timer
+    // with more than one car in a session every remote gets its own time slot,
+    // the remotes have to be switched on together so their slots line up.
+    // the address of the car this remote drives is in driveSetup.hpp
+    const uint8_t SLOTS = 1;
+    const uint8_t SLOT = driveSetup::CAR_ADDRESS - 1;
+    static_assert(SLOTS > 0 && (SLOTS == 1 || SLOT < SLOTS), "every remote needs a slot of its own");
 
-    MovingAverage <uint16_t> joyYAverage(50);
-
-    // Servodriver controller
-
-    bool servoTimerRunning      = false;       // timer running
-    uint32_t timeBetweenServoStep     = 100;         // = versnellingsstap tijd (Time between each step update)
-    uint16_t servoStepsize = 200;         // = volgende PWM waarde (Value of the increment per step)
-    uint_fast64_t servotimer;                // variable that holds the timer
-    int16_t targetRotation = 0;       // = (Target PWM value as read from joystick)
-    int16_t targetDirection = 0;       // = temp value to hold increase/decrease value
-    int16_t previousRotation = 0;         // (Previous value of rotation)
-    int8_t  changePosition = 1;   // 1 = versnellen -1 = vertragen 0 = idle
-    int16_t servoRotation = 0;           // = huidige snelheid (Current PWM value written to board)
-    MovingAverage <uint16_t> joyXAverage(20);
+    auto transmitter = target::pin_out(target::pins::d9);
+    constructMessage message(transmitter, driveSetup::CAR_ADDRESS);
+    slotScheduler slots(SLOT, SLOTS);
+    if (SLOTS > 1) {
+        message.setScheduler(slots);
+    }
 
+    // the ramps, the rates of the channels and the response curves are in driveSetup.hpp,
+    // host/vehiclesim runs the same remoteDrive
+    remoteDrive drive(message);
+
+    // with the stick centered and untouched for IDLE_AFTER_US the remote idles: the drive values go out
+    // as a beacon instead of the refresh, without keepalives in between, and the
+    // core sleeps IDLE_POLL_US between two looks at the stick. moving the stick or pressing it ends the idle
+    const uint32_t IDLE_AFTER_US = 5000000;
+    const uint32_t IDLE_POLL_US = 20000;
+    idleSleep sleeper;
+    bool idle = false;
+    uint_fast64_t lastActivity = hwlib::now_us();
+
+    // a short click of the joystick toggles the lights of the car,
+    // holding it down for PROFILE_PRESS_US switches to the next profile of response curves
+    bool wasClicked = false;
+    const uint32_t PROFILE_PRESS_US = 1000000;
+    uint8_t profileIndex = 0;
+    uint_fast64_t pressStart = 0;
+    bool pressHandled = false;
+
+    // the stick is sampled every SAMPLE_PERIOD_US, also while a frame is on air: the transmitter
+    // polls the sampler between its edges. another inputController, a dualStickController or a pistol grip
+    // of a triggerController and a joystick, goes in the same way, with the axes for X and Y after the windows
+    stickSampler<joystickController> sampler(joy, driveSetup::SAMPLE_PERIOD_US, driveSetup::X_WINDOW, driveSetup::Y_WINDOW);
+
+    // binary records of the loop, the stick and the link, only sent when compiled with RCCAR_TELEMETRY.
+    // the transmitter drains them between its edges too, decode them with host/teledecode
+    telemetry<64> telemetryLog;
+    transmitterStatistics reported;
+    backgroundPair background(sampler, telemetryLog);
+    message.setBackground(background);
+
+
+    // loop profiler, only active when compiled with RCCAR_PROFILE
+    enum section : uint8_t { SAMPLE, CONTROL, TRANSMIT };
+    const char * sectionNames[] = { "sample", "control", "transmit" };
+    loopProfiler<3> profiler(sectionNames);
 
     volatile bool _true = true;
     while (_true) {
-
-        // read joystick value and remap to -2048 - +2048
-        targetSpeed = joyYAverage.CalculateMovingAverage(joy.readY());// - 2048) * 2;
-        targetRotation = joyXAverage.CalculateMovingAverage(joy.readX());
-        //hwlib::cout << "joystick: " << targetRotation;
-
-        targetSpeed = (targetSpeed - 2048) * 2;
-        targetRotation = (targetRotation - 2048) * 2;
-        //hwlib::cout << "  na normalisatie: " << targetRotation;
-
-        if (targetSpeed >= -50 && targetSpeed <= 150){
-            targetSpeed = 0;
-        }
-        if (targetRotation >= -100 && targetRotation <= 100){
-            targetRotation = 0;
+        if (telemetryLog.iteration()) {
+            const transmitterStatistics & link = message.statistics();
+            telemetryLog.record(telemetryType::TX_LINK, link.driveFrames - reported.driveFrames,
+                                link.auxFrames - reported.auxFrames, link.keepalives - reported.keepalives);
+            reported = link;
         }
-        //hwlib::cout << "  na deadzone: " << targetRotation;
 
-        // Pick direction
-        if (targetSpeed < 0){
-            direction = true;
-        } else if (targetSpeed > 0) {
-            direction = false;
+        if (profiler.iteration()) {
+            profiler.report();
+#ifdef RCCAR_PROFILE
+            hwlib::cout << "idle " << (uint32_t) (sleeper.slept() / 1000) << " ms asleep" << hwlib::endl;
+#endif
         }
 
-        // make speed absolute
-        if (targetSpeed < 0){
-            targetSpeed *= -1;
-        }
-        // make rotation temporarily absolute for direction control
-        if (targetRotation < 0){
-            targetDirection = targetRotation * -1;
-        } else {
-            targetDirection = targetRotation;
+        profiler.section(SAMPLE);
+        // the freshest filtered joystick values
+        sampler.poll();
+
+        // the button comes with the last sample, the press is timed by the samples
+        bool pressed = sampler.pressed(joystickController::CLICK);
+        uint_fast64_t sampled = sampler.latest().us;
+        if (pressed && !wasClicked) {
+            pressStart = sampled;
+            pressHandled = false;
+        } else if (pressed && !pressHandled && sampled - pressStart > PROFILE_PRESS_US) {
+            // a long press, the new curves go out with the next frame
+            profileIndex = (profileIndex + 1) % driveSetup::PROFILES;
+            drive.setProfile(driveSetup::profiles[profileIndex]);
+            pressHandled = true;
+        } else if (!pressed && wasClicked && !pressHandled) {
+            drive.toggleLights();
         }
+        wasClicked = pressed;
 
-        if (targetSpeed > previousSpeed) {
-            speedUp_slowDown = 1;
-        } else if (targetSpeed < previousSpeed) {
-            speedUp_slowDown = -1;
-        }else {
-            speedUp_slowDown = 0;
-        }
-        if (targetDirection > previousRotation) {
-            changePosition = 1;
-        } else if (targetDirection < previousRotation) {
-            changePosition = -1;
-        }else {
-            changePosition = 0;
-        }
-
-        //hwlib::cout << " Joystick abs value: " << targetRotation;
+        profiler.section(CONTROL);
+        // only the channels that are due go into the frame, with the latest values
+        uint32_t frame = drive.update(sampler.getX(), sampler.getY(), hwlib::now_us());
 
-        // decide to move
-        if (speedUp_slowDown != 0) {
-            if (!MotortimerRunning) {
-                motortimer = hwlib::now_us();
-                MotortimerRunning = true;
-            }
-        }
-        if (changePosition != 0) {
-            if (!servoTimerRunning) {
-                servotimer = hwlib::now_us();
-                servoTimerRunning = true;
-            }
+        profiler.section(TRANSMIT);
+        if (frame) {
+            telemetryLog.record(telemetryType::STICK, sampler.getX(), sampler.getY(), frame);
         }
-
-        // decide direction to move in
-        if (MotortimerRunning) {
-            if (hwlib::now_us() - motortimer > timeBetweenStep){
-
-                // change acceleration
-                motorAcceleration += (Stepsize * speedUp_slowDown);
-                if (motorAcceleration >= targetSpeed) {
-                    motortimer       = 0;
-                    MotortimerRunning  = false;
-                    motorAcceleration = targetSpeed;
-                } else {
-                    // restart timer
-                    motortimer = hwlib::now_us();
-                }
-            }
+        // an idle remote only sends its beacons
+        if (frame || !idle) {
+            message.makeMessage();
         }
+        RCCAR_TRACE_DUMP_WHEN_FULL();
 
-        if (servoTimerRunning) {
-            if (hwlib::now_us() - servotimer > timeBetweenServoStep){
-
-                // change acceleration
-                servoRotation += (servoStepsize * changePosition);
-                if (servoRotation >= targetRotation) {
-                    servotimer       = 0;
-                    servoTimerRunning  = false;
-                    servoRotation = targetRotation;
-                } else {
-                    // restart timer
-                    servotimer = hwlib::now_us();
-                }
+        if (pressed || drive.active()) {
+            lastActivity = hwlib::now_us();
+            if (idle) {
+                idle = false;
+                drive.setIdle(false);
             }
+        } else if (!idle && hwlib::now_us() - lastActivity > IDLE_AFTER_US) {
+            idle = true;
+            drive.setIdle(true);
         }
-
-        //hwlib::cout << " Servo is: " << servoRotation << "  ";
-
-        if (speedUp_slowDown != 0) {
-            message.setMotorDir(direction);
-            //motor.setDirection(direction);
-            //hwlib::cout << "motor: " << motorAcceleration << "  ";
-            message.setY(motorAcceleration);
-            //motor.setSpeed(motorAcceleration);
-            previousSpeed = motorAcceleration;
-        }
-        if (changePosition != 0) {
-            if(servoRotation < 0){
-                message.setServoDir(false);
-                message.setX(servoRotation*-1);
-            } else {
-                message.setServoDir(true);
-                message.setX(servoRotation);
-            }
-            //ser.setPosition(ser.remapperInverse(servoRotation));
-            previousRotation = servoRotation;
+        telemetryLog.drain();
+        if (idle) {
+            sleeper.sleep_us(IDLE_POLL_US);
         }
-        message.makeMessage();
     }
 }
\ No newline at end of file
@@ -13,6 +13,14 @@
 #include "hwlib.hpp"
 #include "PCA9685.hpp"
 
+/**
+ * \brief what a motorController does with the motor at velocity 0
+ */
+enum class stopMode : uint8_t {
+    COAST,      /**< the bridge lets go, the motor runs out freely */
+    BRAKE       /**< both motor terminals are tied together, the motor stops quickly */
+};
+
 // ==========================================================================
 //
 // motorController, accessed through PCA9685
@@ -28,6 +36,23 @@ protected:
     const uint16_t BACKWARDS;   /**< has a default value of 0 but can be set to allow to run motors with an higher start value */
 
     bool direction;             /**<  true is forward, false backward */
+    stopMode stop;              /**< what setVelocity(0) does */
+
+    /**
+     * \brief write a set of pins in one PCA transaction, or add them to the batch that is already open
+     * the PCA9685 updates its outputs at the stop condition, so the driver sees all pins change at once
+     */
+    template<typename F>
+    void commit(F writes) {
+        bool outer = PCA.inBatch();
+        if (!outer) {
+            PCA.beginBatch();
+        }
+        writes();
+        if (!outer) {
+            PCA.endBatch();
+        }
+    }
 
 public:
     /**
@@ -41,7 +66,8 @@ public:
             PCA( pca ),
             FORWARDS( forwards ),
             BACKWARDS( backwards ),
-            direction(true)
+            direction(true),
+            stop(stopMode::COAST)
     {}
 
     /**
@@ -56,6 +82,21 @@ public:
      */
     virtual void setSpeed(uint16_t speed) = 0;
 
+    /**
+     *  \brief direction and speed in one go, all pins are written in a single PCA transaction.
+     *  at 0 the motor coasts or brakes, see setStopMode()
+     *  @param velocity -4095 (full speed backward) to 4095 (full speed forward)
+     */
+    virtual void setVelocity(int16_t velocity) = 0;
+
+    /**
+     *  \brief choose what setVelocity(0) does
+     *  @param mode COAST or BRAKE, drivers that cannot brake coast
+     */
+    void setStopMode(stopMode mode){
+        stop = mode;
+    }
+
     /**
      *  \brief direction getter.
      */
@@ -71,8 +112,8 @@ public:
 class genericDriver : public motorController {
 private:
 
-    const uint8_t & pwmPin;
-    const uint8_t & dirPin;
+    const uint8_t pwmPin;
+    const uint8_t dirPin;
 
 public:
     /**
@@ -82,7 +123,7 @@ public:
      * @param PWMPIN pin on PCA used to send pwm to motor driver
      * @param DIRPIN pin on PCA used to indicate forwards or backwards to motor driver
      */
-    genericDriver( PCA9685_i2c & pca, const uint8_t & PWMPIN, const uint8_t & DIRPIN ):
+    genericDriver( PCA9685_i2c & pca, uint8_t PWMPIN, uint8_t DIRPIN ):
             motorController( pca ),
             pwmPin( PWMPIN ),
             dirPin( DIRPIN )
@@ -96,6 +137,19 @@ public:
     void setSpeed(uint16_t speed) override {
         PCA.setPin(pwmPin, speed);
     }
+
+    // this driver has no way to short the motor, at 0 it always coasts
+    void setVelocity(int16_t velocity) override {
+        bool forward = velocity >= 0;
+        uint16_t speed = forward ? velocity : -(int32_t) velocity;
+        commit([&]{
+            if (speed) {
+                PCA.setPin(dirPin, (forward ? FORWARDS : BACKWARDS));
+                direction = forward;
+            }
+            PCA.setPin(pwmPin, speed);
+        });
+    }
 };
 
 /**
@@ -105,9 +159,9 @@ public:
 class IBT_2 : public motorController {
 private:
 
-    const uint8_t & pwmPin;
-    const uint8_t & dirPinForward;
-    const uint8_t & dirPinBackward;
+    const uint8_t pwmPin;
+    const uint8_t dirPinForward;
+    const uint8_t dirPinBackward;
 
 public:
     /**
@@ -118,7 +172,7 @@ public:
      * @param forward pin on PCA used to indicate forwards to motor driver
      * @param backward pin on PCA used to indicate backwards to motor driver
      */
-    IBT_2(PCA9685_i2c & pca, const uint8_t & pwmpin, const uint8_t & forward, const uint8_t & backward ):
+    IBT_2(PCA9685_i2c & pca, uint8_t pwmpin, uint8_t forward, uint8_t backward ):
             motorController( pca ),
             pwmPin(pwmpin ),
             dirPinForward(forward ),
@@ -134,6 +188,27 @@ public:
     void setSpeed(uint16_t speed) override {
         PCA.setPin(pwmPin, speed);
     }
+
+    // the pwm pin drives the enables, the direction pins the two half bridges.
+    // braking enables both half bridges with both inputs low, so both low sides conduct
+    void setVelocity(int16_t velocity) override {
+        bool forward = velocity >= 0;
+        uint16_t speed = forward ? velocity : -(int32_t) velocity;
+        commit([&]{
+            if (speed) {
+                PCA.setPin(dirPinForward, (forward ? FORWARDS : BACKWARDS));
+                PCA.setPin(dirPinBackward, (forward ? BACKWARDS : FORWARDS));
+                PCA.setPin(pwmPin, speed);
+                direction = forward;
+            } else if (stop == stopMode::BRAKE) {
+                PCA.setPin(dirPinForward, 0);
+                PCA.setPin(dirPinBackward, 0);
+                PCA.setPin(pwmPin, 4095);
+            } else {
+                PCA.setPin(pwmPin, 0);
+            }
+        });
+    }
 };
 
 #endif //RCCAR_MOTORCONTROLLER_HPP
@@ -0,0 +1,111 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_PULSECAPTURE_HPP
+#define RCCAR_PULSECAPTURE_HPP
+
+#include <hwlib.hpp>
+
+/**
+ * \class pulseCapture. ring buffer with the raw edges a Receiver433mhz has seen
+ * every edge takes one word: the new level in the top bit and the lower 31 bits of
+ * hwlib::now_us() below it, so the timestamps wrap after 35 minutes. once the buffer
+ * is full the oldest edges are overwritten, so it always holds the most recent traffic.
+ * the dump can be replayed on the host with host/replay.
+ */
+class pulseCapture {
+private:
+    uint32_t * buffer;
+    size_t size;
+    size_t next = 0;
+    size_t count = 0;
+
+public:
+    /**
+     * \brief Standard constructor
+     *
+     * @param buffer storage for the edges, it has to outlive this object
+     * @param size number of edges that fit in the buffer
+     */
+    pulseCapture(uint32_t * buffer, size_t size):
+        buffer(buffer),
+        size(size)
+    {}
+
+    /**
+     * \brief store an edge, called by Receiver433mhz
+     *
+     * @param level level of the input after the edge
+     * @param us time of the edge in us
+     */
+    void edge(bool level, uint_fast64_t us) {
+        buffer[next] = ((uint32_t) level << 31) | (uint32_t) (us & 0x7FFFFFFF);
+        next = next + 1 == size ? 0 : next + 1;
+        if (count < size) {
+            count++;
+        }
+    }
+
+    /**
+     * \brief number of edges in the buffer
+     */
+    size_t edges() const {
+        return count;
+    }
+
+    /**
+     * \brief whether the buffer has been filled completely
+     */
+    bool full() const {
+        return count == size;
+    }
+
+    /**
+     * \brief write all edges, oldest first, and empty the buffer
+     * one line per edge: "edge <level> <us>", between "capture-begin <edges>" and "capture-end"
+     *
+     * @param out stream to write to, hwlib::cout on the target
+     */
+    template<typename STREAM>
+    void dump(STREAM & out) {
+        out << "capture-begin " << (uint32_t) count << "\n";
+        size_t first = (next + size - count) % size;
+        for (size_t i = 0; i < count; i++) {
+            uint32_t e = buffer[(first + i) % size];
+            out << "edge " << (int) (e >> 31) << " " << (e & 0x7FFFFFFF) << "\n";
+        }
+        out << "capture-end\n";
+        count = 0;
+    }
+
+    /**
+     * \brief dump to hwlib::cout
+     */
+    void dump() {
+        dump(hwlib::cout);
+    }
+};
+
+/**
+ * \class pulseCaptureBuffer. a pulseCapture together with its storage
+ *
+ * @tparam SIZE number of edges, every edge takes 4 bytes of RAM
+ */
+template<size_t SIZE>
+class pulseCaptureBuffer : public pulseCapture {
+private:
+    uint32_t storage[SIZE];
+
+public:
+    pulseCaptureBuffer():
+        pulseCapture(storage, SIZE)
+    {}
+};
+
+#endif //RCCAR_PULSECAPTURE_HPP
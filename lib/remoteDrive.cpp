@@ -0,0 +1,71 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "remoteDrive.hpp"
+
+using namespace driveSetup;
+
+remoteDrive::remoteDrive(constructMessage & message, const curveProfile & profile, const rampSettings & ramps):
+    message(message),
+    drive(ramps),
+    profile(&profile)
+{
+    configureDrive(DRIVE_REFRESH_US);
+    channels.configure(LIGHTS, LIGHTS_INTERVAL_US, 2, AUX, LIGHTS_REFRESH_US);
+    channels.adapt(STEERING, FULL_RATE_DELTA);
+    channels.adapt(THROTTLE, FULL_RATE_DELTA);
+}
+
+void remoteDrive::configureDrive(uint32_t refreshUs) {
+    channels.configure(STEERING, STEERING_INTERVAL_US, 0, DRIVE, refreshUs);
+    channels.configure(THROTTLE, THROTTLE_INTERVAL_US, 1, DRIVE, refreshUs);
+}
+
+uint32_t remoteDrive::update(uint16_t x, uint16_t y, uint_fast64_t now) {
+    drive.update(x, y, now);
+
+    // the scheduler decides from the values how urgent a frame is,
+    // only the channels that are due go into the frame, with the latest values
+    channels.update(THROTTLE, drive.signedThrottle());
+    channels.update(STEERING, drive.steering());
+    uint32_t frame = channels.pack(now);
+    if (frame & (1u << THROTTLE)) {
+        uint16_t size = profile->throttle.apply(drive.throttle());
+        message.setMotorDir(drive.direction());
+        message.setY(size);
+        sentThrottle = drive.direction() ? size : -size;
+    }
+    if (frame & (1u << STEERING)) {
+        int16_t steering = drive.steering();
+        uint16_t size = profile->steering.apply(steering < 0 ? -steering : steering);
+        message.setServoDir(steering >= 0);
+        message.setX(size);
+        sentSteering = steering >= 0 ? size : -size;
+    }
+    if (frame & (1u << LIGHTS)) {
+        message.setAux(AUX_LIGHTS, lights ? 4095 : 0);
+    }
+    channels.sent(frame, now);
+    return frame;
+}
+
+void remoteDrive::setProfile(const curveProfile & curves) {
+    profile = &curves;
+    channels.changed(THROTTLE);
+    channels.changed(STEERING);
+}
+
+void remoteDrive::toggleLights() {
+    lights = !lights;
+    channels.changed(LIGHTS);
+}
+
+void remoteDrive::setIdle(bool idle) {
+    configureDrive(idle ? IDLE_BEACON_US : DRIVE_REFRESH_US);
+}
@@ -0,0 +1,93 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_REMOTEDRIVE_HPP
+#define RCCAR_REMOTEDRIVE_HPP
+
+#include "hwlib.hpp"
+#include "Transmit433mhzController.hpp"
+#include "channelScheduler.hpp"
+#include "driveSetup.hpp"
+
+/**
+ * \class remoteDrive. what the remote sends for the filtered stick, from the ramps to the fields of a frame
+ * the stick goes through the ramps, the channel scheduler picks the channels that are due and their
+ * values go into the frame through the response curves of the profile. the lights go in aux frames.
+ * mainRemote.cpp calls update() once per loop before makeMessage, host/vehiclesim does the same.
+ */
+class remoteDrive {
+private:
+    constructMessage & message;
+    driveRamps drive;
+    channelScheduler<driveSetup::CHANNELS> channels;
+    const curveProfile * profile;
+    bool lights = false;
+    int32_t sentThrottle = 0;
+    int32_t sentSteering = 0;
+
+    void configureDrive(uint32_t refreshUs);
+
+public:
+    /**
+     * \brief Standard constructor
+     *
+     * @param message the transmitter the frames go out with
+     * @param profile the response curves to start with
+     * @param ramps how the throttle and the steering follow the stick
+     */
+    remoteDrive(constructMessage & message, const curveProfile & profile = driveSetup::profiles[0],
+                const rampSettings & ramps = driveSetup::ramps);
+
+    /**
+     * \brief follow the stick and fill in the channels that are due, call it every loop before makeMessage
+     *
+     * @param x, y filtered stick, 0 to 4095
+     * @param now time in us
+     * @return the channels in the frame, as a mask of driveSetup::channel, 0 when nothing is due
+     */
+    uint32_t update(uint16_t x, uint16_t y, uint_fast64_t now);
+
+    /**
+     * \brief use other response curves, the drive values go out again with the next frame
+     */
+    void setProfile(const curveProfile & curves);
+
+    /**
+     * \brief switch the lights of the car on or off
+     */
+    void toggleLights();
+
+    /**
+     * \brief while idle the drive values are only sent as a beacon every IDLE_BEACON_US
+     */
+    void setIdle(bool idle);
+
+    /**
+     * \brief whether a ramp is still on its way, or the stick is off center
+     */
+    bool active() const {
+        return drive.active();
+    }
+
+    /**
+     * \brief the throttle in the last frame that had it, after the curve: -4095 to 4095, negative is backwards
+     */
+    int32_t throttle() const {
+        return sentThrottle;
+    }
+
+    /**
+     * \brief the steering in the last frame that had it, after the curve: -4095 to 4095
+     */
+    int32_t steering() const {
+        return sentSteering;
+    }
+};
+
+#endif //RCCAR_REMOTEDRIVE_HPP
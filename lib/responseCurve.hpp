@@ -0,0 +1,150 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_RESPONSECURVE_HPP
+#define RCCAR_RESPONSECURVE_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * \class responseCurve. maps a stick deflection of 0 to 4095 onto an output of 0 to 4095
+ * the curve is a table of CURVE_SEGMENTS + 1 points, one every 128 steps of the input up to 4096,
+ * with straight lines in between. the tables are made at compile time by expoCurve, rateCurve and piecewiseCurve,
+ * so applying a curve is a shift, a lookup and one multiplication, there is no curve maths in the loop.
+ * curves work on the size of a deflection, the direction is handled by the caller.
+ */
+class responseCurve {
+public:
+    static constexpr uint8_t SEGMENT_SHIFT = 7;
+    static constexpr uint16_t CURVE_SEGMENTS = 4096 >> SEGMENT_SHIFT;
+
+    uint16_t points[CURVE_SEGMENTS + 1] = {};
+
+    /**
+     * \brief output for an input, interpolated between the two nearest points
+     *
+     * @param input 0 to 4095, larger values are treated as 4095
+     */
+    constexpr uint16_t apply(uint16_t input) const {
+        input = input > 4095 ? 4095 : input;
+        uint16_t segment = input >> SEGMENT_SHIFT;
+        int32_t fraction = input & ((1u << SEGMENT_SHIFT) - 1);
+        int32_t from = points[segment];
+        int32_t to = points[segment + 1];
+        int32_t output = from + (((to - from) * fraction + (1 << (SEGMENT_SHIFT - 1))) >> SEGMENT_SHIFT);
+        // the last point is at 4096 and may be just above 4095
+        return output > 4095 ? 4095 : output;
+    }
+
+    /**
+     * \brief input at a point of the table
+     */
+    static constexpr int32_t inputAt(uint16_t point) {
+        return point << SEGMENT_SHIFT;
+    }
+};
+
+/**
+ * \brief exponential curve with a dual rate, the usual rc expo: y = rate * ((1 - expo) * x + expo * x^3)
+ * a positive expo makes the response soft around the center and keeps the full deflection.
+ *
+ * @param expo 0 (straight) to 100 (cubic), in percent
+ * @param rate 1 to 100, output at full deflection in percent
+ */
+constexpr responseCurve expoCurve(int32_t expo, int32_t rate = 100) {
+    responseCurve curve;
+    for (uint16_t i = 0; i <= responseCurve::CURVE_SEGMENTS; i++) {
+        int64_t x = responseCurve::inputAt(i);
+        int64_t y = ((100 - expo) * x + expo * x * x * x / (4095 * 4095)) / 100;
+        curve.points[i] = y * rate / 100;
+    }
+    return curve;
+}
+
+/**
+ * \brief straight curve that only limits the output, the dual rate switch of a transmitter
+ *
+ * @param rate 1 to 100, output at full deflection in percent
+ */
+constexpr responseCurve rateCurve(int32_t rate) {
+    return expoCurve(0, rate);
+}
+
+/**
+ * \struct curvePoint. a point a piecewiseCurve goes through
+ */
+struct curvePoint {
+    uint16_t input;
+    uint16_t output;
+};
+
+/**
+ * \brief curve with straight lines through a list of points
+ * the points have to start at input 0, end at input 4095 and go up in input, the line through
+ * the last two points is continued to 4096 for the last point of the table
+ *
+ * @param points the points, in order of input
+ */
+template<size_t N>
+constexpr responseCurve piecewiseCurve(const curvePoint (&points)[N]) {
+    static_assert(N >= 2, "a curve needs at least a begin and an end point");
+    responseCurve curve;
+    size_t next = 1;
+    for (uint16_t i = 0; i <= responseCurve::CURVE_SEGMENTS; i++) {
+        int32_t x = responseCurve::inputAt(i);
+        while (next < N - 1 && points[next].input < x) {
+            next++;
+        }
+        const curvePoint & a = points[next - 1];
+        const curvePoint & b = points[next];
+        int32_t span = b.input - a.input;
+        curve.points[i] = a.output + (((int32_t) b.output - a.output) * (x - a.input) + span / 2) / span;
+    }
+    return curve;
+}
+
+/**
+ * \brief whether the output of a curve never goes down, a stick that moves further should never slow down
+ */
+constexpr bool monotonic(const responseCurve & curve) {
+    for (uint16_t i = 0; i < responseCurve::CURVE_SEGMENTS; i++) {
+        if (curve.points[i + 1] < curve.points[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * \struct curveProfile. the curves of one driving style
+ * keep the profiles in a constexpr table and point at the one in use, switching is switching the pointer
+ */
+struct curveProfile {
+    responseCurve throttle;
+    responseCurve steering;
+};
+
+namespace curveCheck {
+    // a straight curve has to give back its input, at and between the points
+    constexpr responseCurve straight = expoCurve(0);
+    static_assert(straight.apply(0) == 0 && straight.apply(1000) == 1000 && straight.apply(4095) == 4095,
+                  "a straight curve changes its input");
+    static_assert(expoCurve(100).apply(4095) == 4095 && expoCurve(100).apply(2048) == 512,
+                  "a full expo curve is not cubic");
+    static_assert(rateCurve(50).apply(4095) == 2048 && rateCurve(50).apply(2048) == 1024,
+                  "a rate curve does not scale the full deflection");
+    static_assert(monotonic(expoCurve(100)) && monotonic(expoCurve(30, 70)), "expo curves have to go up");
+
+    constexpr curvePoint bend[] = { { 0, 0 }, { 2048, 1024 }, { 4095, 4095 } };
+    static_assert(piecewiseCurve(bend).apply(1024) == 512 && piecewiseCurve(bend).apply(2048) == 1024
+                  && piecewiseCurve(bend).apply(4095) == 4095, "a piecewise curve misses its points");
+}
+
+#endif //RCCAR_RESPONSECURVE_HPP
@@ -0,0 +1,78 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_SLOTSCHEDULER_HPP
+#define RCCAR_SLOTSCHEDULER_HPP
+
+#include <hwlib.hpp>
+
+/**
+ * \class slotScheduler. time division of the 433mhz band between several remotes
+ * time is divided in cycles of `slots` slots of `slotUs` each, counted from `epoch`.
+ * a remote only starts a frame in its own slot, and only if the frame ends in time
+ * to leave the receivers a guard time of silence before the next slot starts.
+ *
+ * the remotes have no receiver, so they cannot synchronise on the air: they share
+ * a cycle only if their clocks share the epoch, for instance by being switched on
+ * together. crystal drift then eats into the guard time over the course of a session.
+ * the wait for the slot goes through Transmit433mhzController::waitForSlot, which keeps
+ * polling the background task, a full cycle is far too long to leave the stick unsampled.
+ */
+class slotScheduler {
+private:
+    uint8_t slot;
+    uint8_t slots;
+    uint32_t slotUs;
+    uint32_t guardUs;
+    uint_fast64_t epoch;
+
+public:
+    /**
+     * \brief Standard constructor
+     *
+     * @param slot the slot of this remote, 0 to slots - 1, a higher one is taken as the last slot
+     * @param slots number of slots in a cycle, normally the number of cars. 0 is rejected, it is taken as 1
+     * @param slotUs length of one slot, should hold one frame plus the guard time
+     * @param guardUs silence the receivers need after a frame, more than their 2ms end-of-frame timeout
+     * @param epoch start of the first cycle in hwlib::now_us() time
+     */
+    slotScheduler(uint8_t slot, uint8_t slots, uint32_t slotUs = 30000, uint32_t guardUs = 3000, uint_fast64_t epoch = 0):
+        slot(slots && slot < slots ? slot : (slots ? slots - 1 : 0)),
+        slots(slots ? slots : 1),
+        slotUs(slotUs),
+        guardUs(guardUs),
+        epoch(epoch)
+    {}
+
+    /**
+     * \brief how long to wait before a frame can be started
+     *
+     * @param now current time in us
+     * @param durationUs air time of the frame to send
+     * @return 0 when the frame can start right away, otherwise the number of us until the own slot starts
+     */
+    uint32_t waitTime(uint_fast64_t now, uint32_t durationUs) const {
+        uint_fast64_t cycle = (uint_fast64_t) slots * slotUs;
+        uint32_t phase = (now - epoch) % cycle;
+        uint32_t start = (uint32_t) slot * slotUs;
+        if (phase >= start && phase + durationUs + guardUs <= start + slotUs) {
+            return 0;
+        }
+        return (uint32_t) ((start + cycle - phase) % cycle);
+    }
+
+    /**
+     * \brief whether a transmission of the given length fits in the current slot
+     */
+    bool fits(uint32_t durationUs) const {
+        return waitTime(hwlib::now_us(), durationUs) == 0;
+    }
+};
+
+#endif //RCCAR_SLOTSCHEDULER_HPP
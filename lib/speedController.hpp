@@ -0,0 +1,244 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_SPEEDCONTROLLER_HPP
+#define RCCAR_SPEEDCONTROLLER_HPP
+
+#include "hwlib.hpp"
+#include "motorController.hpp"
+
+/**
+ * \struct pidGains. gains of a speedPID, fixed point with PID_SHIFT fraction bits
+ * speeds are in counts per second of the speed sensor, the output goes to setVelocity
+ */
+struct pidGains {
+    int32_t kp;                 /**< output per count/s of error */
+    int32_t ki;                 /**< output per count/s of error, added every update */
+    int32_t kd;                 /**< output per count/s the speed changed since the last update */
+    int32_t kff;                /**< output per count/s of setpoint, the open loop part */
+    int16_t kickstart;          /**< output added in the direction of the setpoint, for the static friction */
+    int16_t integralLimit;      /**< the most output the integral can add or take away */
+};
+
+/**
+ * \brief number of fraction bits of the gains, a gain of 256 is 1.0
+ */
+constexpr uint8_t PID_SHIFT = 8;
+
+/**
+ * \class speedPID. fixed point PID controller with feed-forward
+ * the feed-forward does most of the work, the feedback only has to correct for the battery
+ * and the load. the derivative is taken from the measurement, so a step of the setpoint does
+ * not kick the output. the integral is limited to integralLimit and stops growing while the
+ * output is saturated in the direction of the error, so it does not wind up.
+ * the output never drives against the setpoint, it is 0 when the car is too fast. that alone does
+ * not keep the motor from being plugged: speedControl coasts through a reversal and decides
+ * whether a 0 brakes or coasts.
+ */
+class speedPID {
+private:
+    pidGains gains;
+    int32_t integral = 0;       /**< with PID_SHIFT fraction bits */
+    int32_t previous = 0;       /**< measurement of the last update */
+
+public:
+    static constexpr int16_t OUTPUT_MAX = 4095;
+
+    /**
+     * \brief Standard constructor
+     *
+     * @param gains see pidGains
+     */
+    explicit speedPID(const pidGains & gains):
+        gains(gains)
+    {}
+
+    /**
+     * \brief one step of the controller, call it at a fixed rate, ki and kd depend on it
+     *
+     * @param setpoint wanted speed in counts per second
+     * @param measured measured speed in counts per second
+     * @return output, 0 to OUTPUT_MAX for a positive setpoint and -OUTPUT_MAX to 0 for a negative one
+     */
+    int16_t update(int32_t setpoint, int32_t measured) {
+        const int32_t limit = (int32_t) gains.integralLimit << PID_SHIFT;
+        int32_t error = setpoint - measured;
+
+        int32_t p = gains.kp * error;
+        int32_t d = -gains.kd * (measured - previous);
+        int32_t ff = gains.kff * setpoint;
+        int32_t kick = setpoint > 0 ? gains.kickstart : (setpoint < 0 ? -gains.kickstart : 0);
+        previous = measured;
+
+        int32_t i = integral + gains.ki * error;
+        i = i > limit ? limit : (i < -limit ? -limit : i);
+
+        int32_t high = setpoint < 0 ? 0 : OUTPUT_MAX;
+        int32_t low = setpoint > 0 ? 0 : -OUTPUT_MAX;
+        int32_t out = ((ff + p + i + d) >> PID_SHIFT) + kick;
+        if (out > high) {
+            out = high;
+            i = error > 0 ? integral : i;
+        } else if (out < low) {
+            out = low;
+            i = error < 0 ? integral : i;
+        }
+        integral = i;
+        return out;
+    }
+
+    /**
+     * \brief forget the integral and the last measurement, for a fresh start from standstill
+     */
+    void reset() {
+        integral = 0;
+        previous = 0;
+    }
+
+    /**
+     * \brief the part of the output that comes from the integral
+     */
+    int16_t integralOutput() const {
+        return integral >> PID_SHIFT;
+    }
+};
+
+/**
+ * \class speedControl. closes the loop between a speed sensor and a motor driver
+ * the motor is anything with setVelocity(int16_t), the sensor anything with poll(), sample(now)
+ * and setDirection(forward), see speedSensor.hpp. both are template parameters, so the loop has
+ * no virtual calls. a setpoint of 0 stops the motor with the stop mode and resets the controller.
+ * the motor is never driven against the way the wheels turn, that would plug it: when the setpoint
+ * changes sign while the car moves the output is 0 and the motor coasts, until the sensor reads
+ * standstill. a speed a little above the setpoint coasts down too, the stop mode is only used
+ * when the car is more than 1 / OVERSPEED_BRAKE above it, a full brake every period for a few
+ * counts too many would jerk the car.
+ *
+ * @tparam SENSOR speed sensor type
+ * @tparam MOTOR motor driver type
+ */
+template<typename SENSOR, typename MOTOR>
+class speedControl {
+private:
+    SENSOR & sensor;
+    MOTOR & motor;
+    speedPID pid;
+    uint32_t periodUs;
+    uint_fast64_t lastUpdate = 0;
+    int32_t target = 0;
+    int32_t measured = 0;
+    int16_t output = 0;
+    stopMode stop = stopMode::COAST;
+
+public:
+    static constexpr int32_t OVERSPEED_BRAKE = 4;   /**< brake above 1 + 1/OVERSPEED_BRAKE times the setpoint */
+
+    /**
+     * \brief Standard constructor
+     *
+     * @param sensor the speed sensor
+     * @param motor the motor driver
+     * @param gains gains of the PID, tuned for periodUs
+     * @param periodUs time between updates in us
+     */
+    speedControl(SENSOR & sensor, MOTOR & motor, const pidGains & gains, uint32_t periodUs):
+        sensor(sensor),
+        motor(motor),
+        pid(gains),
+        periodUs(periodUs)
+    {}
+
+    /**
+     * \brief set the wanted speed
+     *
+     * @param countsPerSecond speed in counts per second of the sensor, negative is backward
+     */
+    void setTarget(int32_t countsPerSecond) {
+        target = countsPerSecond;
+    }
+
+    /**
+     * \brief choose how the car stops at a setpoint of 0 and slows down when it is far too fast,
+     * set it here and not on the motor, the loop sets the stop mode of the motor every update
+     *
+     * @param mode COAST or BRAKE
+     */
+    void setStopMode(stopMode mode) {
+        stop = mode;
+    }
+
+    /**
+     * \brief poll the sensor and, once per period, update the motor. call it every loop
+     *
+     * @param mayWrite false holds back an update that is due, the sensor is still polled
+     * @return whether the motor was written
+     */
+    bool loop(bool mayWrite = true) {
+        sensor.poll();
+        uint_fast64_t now = hwlib::now_us();
+        if (!mayWrite || now - lastUpdate < periodUs) {
+            return false;
+        }
+        lastUpdate = now;
+        measured = sensor.sample(now);
+        stopMode mode = stop;
+        if (target == 0) {
+            pid.reset();
+            output = 0;
+        } else if ((target > 0 && measured < 0) || (target < 0 && measured > 0)) {
+            // a reversal, the wheels still turn the old way: coast until they stop
+            pid.reset();
+            output = 0;
+            mode = stopMode::COAST;
+        } else {
+            output = pid.update(target, measured);
+            int32_t speed = measured < 0 ? -measured : measured;
+            int32_t wanted = target < 0 ? -target : target;
+            if (output == 0 && speed <= wanted + wanted / OVERSPEED_BRAKE) {
+                mode = stopMode::COAST;
+            }
+        }
+        if (output) {
+            sensor.setDirection(output > 0);
+        }
+        motor.setStopMode(mode);
+        motor.setVelocity(output);
+        return true;
+    }
+
+    /**
+     * \brief the wanted speed, in counts per second
+     */
+    int32_t getTarget() const {
+        return target;
+    }
+
+    /**
+     * \brief speed measured at the last update, in counts per second
+     */
+    int32_t getMeasured() const {
+        return measured;
+    }
+
+    /**
+     * \brief output of the last update
+     */
+    int16_t getOutput() const {
+        return output;
+    }
+
+    /**
+     * \brief the underlying PID
+     */
+    const speedPID & getPID() const {
+        return pid;
+    }
+};
+
+#endif //RCCAR_SPEEDCONTROLLER_HPP
@@ -0,0 +1,204 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_SPEEDSENSOR_HPP
+#define RCCAR_SPEEDSENSOR_HPP
+
+#include "hwlib.hpp"
+
+// Speed sensors for speedControl. A sensor has poll(), called every loop to look for edges,
+// sample(now), which returns the speed in counts per second, and setDirection(forward).
+// The inputs are polled, so an edge has to last longer than the slowest loop iteration,
+// a PCA9685 batch takes about 1.3ms. Put the sensor after the gearbox, a hall sensor with
+// a few magnets on the driveshaft is fast enough.
+
+/**
+ * \class edgeRate. turns timestamped counts into a speed
+ * the speed is the number of counts divided by the time between the first and the last count
+ * of a sample, so it does not depend on how the counts fall in the sample period. without new
+ * counts the speed is limited to one count in the time since the last one, so it goes to 0
+ * when the wheels stop instead of holding the last value.
+ */
+class edgeRate {
+private:
+    int32_t count = 0;                  /**< counts since reference, signed */
+    uint_fast64_t reference = 0;        /**< time of the count the current sample is measured from */
+    uint_fast64_t last = 0;             /**< time of the latest count */
+    bool running = false;               /**< whether reference belongs to the current movement */
+    int32_t speed = 0;
+
+public:
+    static constexpr uint32_t TIMEOUT_US = 250000;    /**< no counts for this long is standstill */
+
+    /**
+     * \brief one count
+     *
+     * @param step +1 forward, -1 backward
+     * @param us time of the count
+     */
+    void edge(int8_t step, uint_fast64_t us) {
+        if (!running) {
+            // the first count after standstill has no earlier count to be timed from
+            reference = us;
+            running = true;
+            return;
+        }
+        count += step;
+        last = us;
+    }
+
+    /**
+     * \brief speed since the previous sample
+     *
+     * @param now current time in us
+     * @return counts per second, negative backward
+     */
+    int32_t sample(uint_fast64_t now) {
+        if (count != 0 && last > reference) {
+            speed = (int64_t) count * 1000000 / (int64_t) (last - reference);
+            reference = last;
+            count = 0;
+        } else if (!running || now - reference > TIMEOUT_US) {
+            running = false;
+            count = 0;
+            speed = 0;
+        } else {
+            int32_t bound = 1000000 / (now - reference + 1);
+            speed = speed > bound ? bound : (speed < -bound ? -bound : speed);
+        }
+        return speed;
+    }
+
+    /**
+     * \brief whether there have been counts recently, see TIMEOUT_US
+     */
+    bool moving() const {
+        return running;
+    }
+};
+
+/**
+ * \class tachometer. one pulse input, every edge is a count
+ * a single channel cannot see which way the wheels turn, the direction follows the motor command.
+ * the wheels have to stop before they can turn the other way, so it only changes at standstill
+ */
+class tachometer {
+private:
+    hwlib::pin_in & input;
+    edgeRate rate;
+    bool level = false;
+    bool forward = true;
+
+public:
+    /**
+     * \brief Standard constructor
+     *
+     * @param input pin the sensor is connected to
+     */
+    explicit tachometer(hwlib::pin_in & input):
+        input(input)
+    {}
+
+    /**
+     * \brief look for an edge, call this as often as possible
+     */
+    void poll() {
+        bool l = input.read();
+        if (l != level) {
+            level = l;
+            rate.edge(forward ? 1 : -1, hwlib::now_us());
+        }
+    }
+
+    /**
+     * \brief speed in counts per second, see edgeRate::sample
+     */
+    int32_t sample(uint_fast64_t now) {
+        return rate.sample(now);
+    }
+
+    /**
+     * \brief the direction the motor is driven in, ignored while the wheels turn
+     */
+    void setDirection(bool f) {
+        if (!rate.moving()) {
+            forward = f;
+        }
+    }
+};
+
+/**
+ * \class quadratureEncoder. two channels 90 degrees apart, every edge on either channel is a count
+ * transitions where both channels change at once were missed edges, they are counted in errors()
+ */
+class quadratureEncoder {
+private:
+    hwlib::pin_in & a;
+    hwlib::pin_in & b;
+    edgeRate rate;
+    uint8_t state = 0;
+    uint32_t missed = 0;
+
+public:
+    /**
+     * \brief Standard constructor
+     *
+     * @param a channel A of the encoder
+     * @param b channel B of the encoder, B leads A when driving forward
+     */
+    quadratureEncoder(hwlib::pin_in & a, hwlib::pin_in & b):
+        a(a),
+        b(b)
+    {}
+
+    /**
+     * \brief look for an edge, call this as often as possible
+     */
+    void poll() {
+        // index is the previous state in the top two bits and the new state below them
+        static constexpr int8_t steps[16] = {
+             0,  1, -1,  0,
+            -1,  0,  0,  1,
+             1,  0,  0, -1,
+             0, -1,  1,  0
+        };
+        uint8_t next = (a.read() << 1) | b.read();
+        if (next == state) {
+            return;
+        }
+        int8_t step = steps[(state << 2) | next];
+        state = next;
+        if (step) {
+            rate.edge(step, hwlib::now_us());
+        } else {
+            missed++;
+        }
+    }
+
+    /**
+     * \brief speed in counts per second, see edgeRate::sample
+     */
+    int32_t sample(uint_fast64_t now) {
+        return rate.sample(now);
+    }
+
+    /**
+     * \brief the encoder sees the direction itself
+     */
+    void setDirection(bool) {}
+
+    /**
+     * \brief number of transitions where both channels changed at once
+     */
+    uint32_t errors() const {
+        return missed;
+    }
+};
+
+#endif //RCCAR_SPEEDSENSOR_HPP
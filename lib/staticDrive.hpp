@@ -0,0 +1,220 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_STATICDRIVE_HPP
+#define RCCAR_STATICDRIVE_HPP
+
+#include "hwlib.hpp"
+#include "PCA9685.hpp"
+#include "motorController.hpp"
+
+// Compile time configured versions of the motorController drivers and the servo.
+// Pins, ranges and limits are template parameters, there are no virtual functions,
+// so a command folds into the PCA9685_i2c register writes. A configuration with a
+// pin that does not exist, or two functions on one pin, does not compile.
+
+/**
+ * \brief whether none of the parts share a pin, every part has a PINS mask
+ */
+template<typename... PARTS>
+constexpr bool pinsDisjoint() {
+    uint16_t seen = 0;
+    bool disjoint = true;
+    ((disjoint = disjoint && !(seen & PARTS::PINS), seen |= PARTS::PINS), ...);
+    return disjoint;
+}
+
+/**
+ * \class staticMotorController. CRTP base of the compile time configured motor drivers
+ * the driver supplies MAX_SPEED and write(forward, speed), this class does the rest
+ *
+ * @tparam DRIVER the driver class that derives from this one
+ */
+template<typename DRIVER>
+class staticMotorController {
+protected:
+    PCA9685_i2c & PCA;
+    bool direction = true;              /**<  true is forward, false backward */
+    stopMode stop = stopMode::COAST;    /**< what setVelocity(0) does */
+
+public:
+    /**
+     * \brief Standard constructor
+     *
+     * @param pca reference to the PCA object the driver is connected to
+     */
+    explicit staticMotorController(PCA9685_i2c & pca):
+        PCA(pca)
+    {}
+
+    /**
+     *  \brief direction and speed in one go, all pins are written in a single PCA transaction
+     *  or added to the batch that is already open, like motorController::setVelocity
+     *  @param velocity -4095 (full speed backward) to 4095 (full speed forward), limited to MAX_SPEED
+     */
+    void setVelocity(int16_t velocity) {
+        bool forward = velocity >= 0;
+        uint16_t speed = forward ? velocity : -(int32_t) velocity;
+        speed = speed > DRIVER::MAX_SPEED ? DRIVER::MAX_SPEED : speed;
+        bool outer = PCA.inBatch();
+        if (!outer) {
+            PCA.beginBatch();
+        }
+        static_cast<DRIVER &>(*this).write(forward, speed);
+        if (!outer) {
+            PCA.endBatch();
+        }
+        if (speed) {
+            direction = forward;
+        }
+    }
+
+    /**
+     *  \brief choose what setVelocity(0) does
+     *  @param mode COAST or BRAKE, drivers that cannot brake coast
+     */
+    void setStopMode(stopMode mode) {
+        stop = mode;
+    }
+
+    /**
+     *  \brief direction getter.
+     */
+    bool getDirection() const {
+        return direction;
+    }
+};
+
+/**
+ * \class staticGenericDriver. genericDriver with its pins fixed at compile time
+ *
+ * @tparam PWM_PIN pin on PCA used to send pwm to motor driver
+ * @tparam DIR_PIN pin on PCA used to indicate forwards or backwards to motor driver
+ * @tparam SPEED_LIMIT highest pwm value, 1 to 4095
+ */
+template<uint8_t PWM_PIN, uint8_t DIR_PIN, uint16_t SPEED_LIMIT = 4095>
+class staticGenericDriver : public staticMotorController<staticGenericDriver<PWM_PIN, DIR_PIN, SPEED_LIMIT>> {
+    static_assert(PWM_PIN < 16 && DIR_PIN < 16, "the PCA9685 has pins 0 to 15");
+    static_assert(PWM_PIN != DIR_PIN, "every function needs its own pin");
+    static_assert(SPEED_LIMIT > 0 && SPEED_LIMIT <= 4095, "the pwm of the PCA9685 goes from 0 to 4095");
+
+    using base = staticMotorController<staticGenericDriver>;
+    friend base;
+
+    // this driver has no way to short the motor, at 0 it always coasts
+    void write(bool forward, uint16_t speed) {
+        if (speed) {
+            this->PCA.setPin(DIR_PIN, forward ? 4095 : 0);
+        }
+        this->PCA.setPin(PWM_PIN, speed);
+    }
+
+public:
+    static constexpr uint16_t PINS = (1u << PWM_PIN) | (1u << DIR_PIN);
+    static constexpr uint16_t MAX_SPEED = SPEED_LIMIT;
+
+    using base::base;
+};
+
+/**
+ * \class staticIBT_2. IBT_2 with its pins fixed at compile time
+ *
+ * @tparam PWM_PIN pin on PCA used to send pwm to the enables of the motor driver
+ * @tparam FORWARD_PIN pin on PCA used to indicate forwards to motor driver
+ * @tparam BACKWARD_PIN pin on PCA used to indicate backwards to motor driver
+ * @tparam SPEED_LIMIT highest pwm value, 1 to 4095
+ */
+template<uint8_t PWM_PIN, uint8_t FORWARD_PIN, uint8_t BACKWARD_PIN, uint16_t SPEED_LIMIT = 4095>
+class staticIBT_2 : public staticMotorController<staticIBT_2<PWM_PIN, FORWARD_PIN, BACKWARD_PIN, SPEED_LIMIT>> {
+    static_assert(PWM_PIN < 16 && FORWARD_PIN < 16 && BACKWARD_PIN < 16, "the PCA9685 has pins 0 to 15");
+    static_assert(PWM_PIN != FORWARD_PIN && PWM_PIN != BACKWARD_PIN && FORWARD_PIN != BACKWARD_PIN,
+                  "every function needs its own pin");
+    static_assert(SPEED_LIMIT > 0 && SPEED_LIMIT <= 4095, "the pwm of the PCA9685 goes from 0 to 4095");
+
+    using base = staticMotorController<staticIBT_2>;
+    friend base;
+
+    // same pin states as IBT_2::setVelocity
+    void write(bool forward, uint16_t speed) {
+        if (speed) {
+            this->PCA.setPin(FORWARD_PIN, forward ? 4095 : 0);
+            this->PCA.setPin(BACKWARD_PIN, forward ? 0 : 4095);
+            this->PCA.setPin(PWM_PIN, speed);
+        } else if (this->stop == stopMode::BRAKE) {
+            this->PCA.setPin(FORWARD_PIN, 0);
+            this->PCA.setPin(BACKWARD_PIN, 0);
+            this->PCA.setPin(PWM_PIN, 4095);
+        } else {
+            this->PCA.setPin(PWM_PIN, 0);
+        }
+    }
+
+public:
+    static constexpr uint16_t PINS = (1u << PWM_PIN) | (1u << FORWARD_PIN) | (1u << BACKWARD_PIN);
+    static constexpr uint16_t MAX_SPEED = SPEED_LIMIT;
+
+    using base::base;
+};
+
+/**
+ * \class staticServo. servo with its pin, input range and pulse lengths fixed at compile time
+ * the mapping is done in integers, the Due has no FPU
+ *
+ * @tparam PIN number of the servo pin on the PCA board
+ * @tparam RANGE_MIN minimum input value of the map function
+ * @tparam RANGE_MAX maximum input value of the map function
+ * @tparam US_MIN pulse length at RANGE_MIN
+ * @tparam US_MAX pulse length at RANGE_MAX
+ */
+template<uint8_t PIN, int16_t RANGE_MIN, int16_t RANGE_MAX, uint16_t US_MIN = 500, uint16_t US_MAX = 2500>
+class staticServo {
+    static_assert(PIN < 16, "the PCA9685 has pins 0 to 15");
+    static_assert(RANGE_MIN < RANGE_MAX, "the input range is empty");
+    static_assert(US_MIN < US_MAX && US_MAX <= 20000, "the pulses have to fit in the 20ms period of a servo");
+
+private:
+    PCA9685_i2c & PCA;
+
+public:
+    static constexpr uint16_t PINS = 1u << PIN;
+
+    /**
+     * \brief Standard constructor
+     *
+     * @param pca reference to the PCA object the servo is connected to
+     */
+    explicit staticServo(PCA9685_i2c & pca):
+        PCA(pca)
+    {}
+
+    /**
+     * \brief function to set position
+     *
+     * @param pos the position in microseconds
+     */
+    void setPosition(uint16_t pos) {
+        PCA.writeMicroseconds(PIN, pos);
+    }
+
+    /**
+     * \brief maps the input range onto US_MIN to US_MAX
+     */
+    static constexpr int16_t map(int_fast16_t val) {
+        return US_MIN + (int32_t) (US_MAX - US_MIN) * (val - RANGE_MIN) / (RANGE_MAX - RANGE_MIN);
+    }
+
+    /**
+     * \brief maps the input range onto US_MAX to US_MIN
+     */
+    static constexpr int16_t mapInverse(int_fast16_t val) {
+        return US_MAX - (int32_t) (US_MAX - US_MIN) * (val - RANGE_MIN) / (RANGE_MAX - RANGE_MIN);
+    }
+};
+
+#endif //RCCAR_STATICDRIVE_HPP
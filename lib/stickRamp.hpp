@@ -0,0 +1,209 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_STICKRAMP_HPP
+#define RCCAR_STICKRAMP_HPP
+
+#include <stdint.h>
+
+/**
+ * \class stickRamp. moves a value towards a target in steps of stepSize, one step every stepUs
+ * the first step is taken right away, so it rides along with the next frame. the ramp ends at the target,
+ * from either side. with rampDown false a target below the value is taken at once, the throttle slows down
+ * without a ramp.
+ */
+class stickRamp {
+private:
+    uint16_t stepSize;
+    uint32_t stepUs;
+    bool rampDown;
+    int32_t current = 0;
+    int8_t change = 0;                  /**< 1 going up, -1 going down, 0 at the target */
+    bool running = false;
+    uint_fast64_t timer = 0;
+
+public:
+    /**
+     * \brief Standard constructor
+     *
+     * @param stepSize size of one step
+     * @param stepUs time between two steps
+     * @param rampDown whether a lower target is ramped too
+     */
+    constexpr stickRamp(uint16_t stepSize, uint32_t stepUs, bool rampDown = true):
+        stepSize(stepSize),
+        stepUs(stepUs),
+        rampDown(rampDown)
+    {}
+
+    /**
+     * \brief take a step towards the target when one is due, call it every loop
+     *
+     * @param target the value to go to
+     * @param now time in us
+     */
+    constexpr void update(int32_t target, uint_fast64_t now) {
+        change = target > current ? 1 : target < current ? -1 : 0;
+        if (change != 0 && !running) {
+            timer = now - stepUs - 1;
+            running = true;
+        }
+        if (running && now - timer > stepUs) {
+            current += stepSize * change;
+            bool reached = change < 0 ? !rampDown || current <= target : current >= target;
+            if (reached) {
+                running = false;
+                current = target;
+            } else {
+                timer = now;
+            }
+        }
+    }
+
+    /**
+     * \brief the value of the ramp
+     */
+    constexpr int32_t value() const {
+        return current;
+    }
+
+    /**
+     * \brief whether the last update was away from the target
+     */
+    constexpr bool moving() const {
+        return change != 0;
+    }
+};
+
+/**
+ * \struct rampSettings. how the remote turns the stick into the values it sends
+ * the steps are in the -4096 to 4096 range of driveRamps, the dead zones in the same units
+ */
+struct rampSettings {
+    uint16_t throttleStep = 80;         /**< throttle step */
+    uint32_t throttleStepUs = 100;      /**< time between two throttle steps */
+    bool throttleRampDown = false;      /**< whether a lower throttle is ramped too, false takes it at once */
+    uint16_t steeringStep = 200;        /**< steering step, ramps both ways */
+    uint32_t steeringStepUs = 100;      /**< time between two steering steps */
+    int16_t throttleDeadLow = -50;      /**< throttle values from here up to throttleDeadHigh are 0 */
+    int16_t throttleDeadHigh = 150;
+    int16_t steeringDead = 100;         /**< steering values within this of the center are 0 */
+};
+
+/**
+ * \class driveRamps. the throttle and steering of the remote, from the filtered stick to the values of a frame
+ * the stick values of 0 to 4095 are centered and doubled, get a dead zone and are ramped.
+ * a stick below the center is forward, the throttle is a size and a direction, the steering is signed.
+ */
+class driveRamps {
+private:
+    rampSettings settings;
+    stickRamp throttleRamp;
+    stickRamp steeringRamp;
+    bool forward = true;
+    bool centered = true;
+
+public:
+    /**
+     * \brief Standard constructor
+     *
+     * @param settings see rampSettings
+     */
+    constexpr explicit driveRamps(const rampSettings & settings = rampSettings()):
+        settings(settings),
+        throttleRamp(settings.throttleStep, settings.throttleStepUs, settings.throttleRampDown),
+        steeringRamp(settings.steeringStep, settings.steeringStepUs)
+    {}
+
+    /**
+     * \brief follow the stick, call it every loop
+     *
+     * @param x, y filtered stick, 0 to 4095
+     * @param now time in us
+     */
+    constexpr void update(uint16_t x, uint16_t y, uint_fast64_t now) {
+        int32_t speed = ((int32_t) y - 2048) * 2;
+        int32_t rotation = ((int32_t) x - 2048) * 2;
+        if (speed >= settings.throttleDeadLow && speed <= settings.throttleDeadHigh) {
+            speed = 0;
+        }
+        if (rotation >= -settings.steeringDead && rotation <= settings.steeringDead) {
+            rotation = 0;
+        }
+        if (speed < 0) {
+            forward = true;
+        } else if (speed > 0) {
+            forward = false;
+        }
+        centered = speed == 0 && rotation == 0;
+        throttleRamp.update(speed < 0 ? -speed : speed, now);
+        steeringRamp.update(rotation, now);
+    }
+
+    /**
+     * \brief direction of the throttle, kept when the stick is centered
+     */
+    constexpr bool direction() const {
+        return forward;
+    }
+
+    /**
+     * \brief size of the throttle, 0 to 4096
+     */
+    constexpr uint16_t throttle() const {
+        return throttleRamp.value();
+    }
+
+    /**
+     * \brief the throttle with its direction, negative is backwards
+     */
+    constexpr int32_t signedThrottle() const {
+        return forward ? throttleRamp.value() : -throttleRamp.value();
+    }
+
+    /**
+     * \brief steering, -4096 to 4096
+     */
+    constexpr int16_t steering() const {
+        return steeringRamp.value();
+    }
+
+    /**
+     * \brief whether a ramp is still on its way, or the stick is off center
+     */
+    constexpr bool active() const {
+        return throttleRamp.moving() || steeringRamp.moving() || !centered;
+    }
+};
+
+namespace rampCheck {
+    constexpr int32_t steeringAfter(uint_fast64_t us, int32_t target) {
+        stickRamp ramp(200, 100);
+        for (uint_fast64_t t = 1000; t <= 1000 + us; t += 50) {
+            ramp.update(target, t);
+        }
+        return ramp.value();
+    }
+    static_assert(steeringAfter(0, 1000) == 200 && steeringAfter(100, 1000) == 200 && steeringAfter(150, 1000) == 400,
+                  "a ramp has to step right away and then once every step time");
+    static_assert(steeringAfter(1000, 1000) == 1000 && steeringAfter(1000, -700) == -700,
+                  "a ramp has to end at its target");
+
+    constexpr int32_t throttleDown() {
+        stickRamp ramp(80, 100, false);
+        for (uint_fast64_t t = 1000; t <= 5000; t += 50) {
+            ramp.update(2000, t);
+        }
+        ramp.update(500, 5050);
+        return ramp.value();
+    }
+    static_assert(throttleDown() == 500, "a ramp without rampDown has to take a lower target at once");
+}
+
+#endif //RCCAR_STICKRAMP_HPP
@@ -0,0 +1,115 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_STICKSAMPLER_HPP
+#define RCCAR_STICKSAMPLER_HPP
+
+#include <hwlib.hpp>
+#include "backgroundTask.hpp"
+#include "inputController.hpp"
+#include "MovingAverage.hpp"
+
+/**
+ * \class stickSampler. samples and filters the joystick at a fixed rate, also while a frame is on air
+ * the transmitter polls it between its edges and the main loop at its top, so the moving averages
+ * keep filling during makeMessage and the next frame picks up the freshest filtered values.
+ * with a fixed sample period the filters average over a fixed time instead of a number of loops.
+ * SOURCE is any inputController, the sampler filters two of its axes as X and Y and keeps the
+ * last snapshot for the buttons. it calls the device as its own type, not through the base class.
+ */
+template<class SOURCE>
+class stickSampler : public backgroundTask {
+private:
+    SOURCE & source;
+    uint32_t periodUs;
+    uint8_t xAxis, yAxis;
+    uint_fast64_t next = 0;
+    MovingAverage<uint16_t> xAverage;
+    MovingAverage<uint16_t> yAverage;
+    uint16_t x = 2048;
+    uint16_t y = 2048;
+    typename SOURCE::snapshot last;
+    uint32_t samples = 0;
+
+public:
+    /**
+     * \brief Standard constructor
+     *
+     * @param source the joystick, or another input
+     * @param periodUs time between two samples
+     * @param xLength number of samples the X filter averages, at most 100
+     * @param yLength number of samples the Y filter averages, at most 100
+     * @param xAxis, yAxis axes of the source that are filtered as X and Y
+     */
+    stickSampler(SOURCE & source, uint32_t periodUs, uint16_t xLength, uint16_t yLength,
+                 uint8_t xAxis = 0, uint8_t yAxis = 1):
+        source(source),
+        periodUs(periodUs),
+        xAxis(xAxis),
+        yAxis(yAxis),
+        xAverage(xLength),
+        yAverage(yLength)
+    {
+        last.axis[xAxis] = x;
+        last.axis[yAxis] = y;
+    }
+
+    /**
+     * \brief take a sample when one is due. a sample that is late does not make the next one early,
+     * after a long wait the filter gets one sample and carries on at its period
+     */
+    void poll() override {
+        uint_fast64_t now = hwlib::now_us();
+        if (now < next) {
+            return;
+        }
+        next = now - next < periodUs ? next + periodUs : now + periodUs;
+        last = source.read();
+        x = xAverage.CalculateMovingAverage(last.axis[xAxis]);
+        y = yAverage.CalculateMovingAverage(last.axis[yAxis]);
+        samples++;
+    }
+
+    /**
+     * \brief filtered X, 0 to 4095
+     */
+    uint16_t getX() const {
+        return x;
+    }
+
+    /**
+     * \brief filtered Y, 0 to 4095
+     */
+    uint16_t getY() const {
+        return y;
+    }
+
+    /**
+     * \brief the last sample as it was read, unfiltered, with its time and the buttons
+     */
+    const typename SOURCE::snapshot & latest() const {
+        return last;
+    }
+
+    /**
+     * \brief whether a button was pressed in the last sample
+     */
+    bool pressed(uint8_t button) const {
+        return last.pressed(button);
+    }
+
+    /**
+     * \brief number of samples taken
+     */
+    uint32_t getSamples() const {
+        return samples;
+    }
+};
+
+#endif //RCCAR_STICKSAMPLER_HPP
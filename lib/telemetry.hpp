@@ -0,0 +1,263 @@
+/*
+ *
+ * Copyright Luc de Haas
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RCCAR_TELEMETRY_HPP
+#define RCCAR_TELEMETRY_HPP
+
+#include <hwlib.hpp>
+#include "backgroundTask.hpp"
+
+/**
+ * \brief what a telemetry record holds, the meaning of a, b and c depends on it
+ */
+enum class telemetryType : uint8_t {
+    LOOP,       /**< a: loop iterations since the last LOOP record, b: longest of them in us, c: 0 */
+    RX_LINK,    /**< a: frames accepted since the last RX_LINK record, b: rejected by checksum or address, c: damaged */
+    TX_LINK,    /**< a: drive frames sent since the last TX_LINK record, b: aux frames, c: keepalives */
+    MOTOR,      /**< a: target in counts/s, b: measured speed in counts/s, c: output of the speed controller */
+    STEERING,   /**< a: X of the frame, signed by the servo direction, b: servo pulse in us, c: 0 */
+    STICK,      /**< a: filtered X, b: filtered Y, both 0 to 4095, c: channels in the frame that was sent */
+    WAKE,       /**< a: wakes of the PCA9685 so far, b: latency of the last one in us, c: 0, a and b stop at INT16_MAX */
+    TYPES
+};
+
+/**
+ * \brief layout of a record on the serial line, little endian:
+ * sync, type, sequence, time in us (4 bytes), a, b, c (2 bytes each), checksum.
+ * the sequence counts every record that was offered, so a gap shows records that were
+ * dropped because the buffer was full. the checksum is the complement of the sum of the
+ * bytes from type up to c, a record that is damaged or cut by text on the line is skipped
+ */
+namespace telemetryWire {
+    constexpr uint8_t SYNC = 0xA5;
+    constexpr size_t RECORD_BYTES = 14;
+
+    /**
+     * \brief checksum over the bytes from type up to c
+     */
+    constexpr uint8_t checksum(const uint8_t * bytes) {
+        uint8_t sum = 0;
+        for (size_t i = 1; i < RECORD_BYTES - 1; i++) {
+            sum += bytes[i];
+        }
+        return ~sum;
+    }
+}
+
+/**
+ * \struct telemetryRecord. one record as it is kept in the buffer
+ */
+struct telemetryRecord {
+    uint32_t us;
+    int16_t a, b, c;
+    telemetryType type;
+    uint8_t sequence;
+
+    /**
+     * \brief the record as it goes on the line, see telemetryWire
+     */
+    void toBytes(uint8_t * bytes) const {
+        bytes[0] = telemetryWire::SYNC;
+        bytes[1] = (uint8_t) type;
+        bytes[2] = sequence;
+        for (size_t i = 0; i < 4; i++) {
+            bytes[3 + i] = us >> (8 * i);
+        }
+        int16_t values[3] = { a, b, c };
+        for (size_t i = 0; i < 3; i++) {
+            bytes[7 + 2 * i] = (uint16_t) values[i];
+            bytes[8 + 2 * i] = (uint16_t) values[i] >> 8;
+        }
+        bytes[13] = telemetryWire::checksum(bytes);
+    }
+
+    /**
+     * \brief read a record back from the line, the sync and checksum have to be checked by the caller
+     */
+    static telemetryRecord fromBytes(const uint8_t * bytes) {
+        telemetryRecord r;
+        r.type = (telemetryType) bytes[1];
+        r.sequence = bytes[2];
+        r.us = bytes[3] | (uint32_t) bytes[4] << 8 | (uint32_t) bytes[5] << 16 | (uint32_t) bytes[6] << 24;
+        r.a = (int16_t) (bytes[7] | bytes[8] << 8);
+        r.b = (int16_t) (bytes[9] | bytes[10] << 8);
+        r.c = (int16_t) (bytes[11] | bytes[12] << 8);
+        return r;
+    }
+};
+
+/**
+ * \class telemetryStream. ring buffer of records that drains to the serial port without waiting
+ * record() only copies 12 bytes into the buffer, drain() writes bytes only while the UART can take
+ * them right away, so neither stalls the loop the way text through hwlib::cout does.
+ * call drain() every loop, or poll the stream as a backgroundTask in code that waits.
+ * when the buffer is full new records are dropped, the gap in the sequence shows it.
+ * text on the same port can still be written, the decoder skips it, but a record that is
+ * cut by text is lost. decode the stream with host/teledecode.
+ *
+ * @tparam SIZE number of records the buffer holds
+ */
+template<size_t SIZE>
+class telemetryStream : public backgroundTask {
+public:
+    static constexpr uint32_t REPORT_US = 100000;   /**< period of the LOOP record */
+
+private:
+    telemetryRecord records[SIZE];
+    size_t first = 0;
+    size_t count = 0;
+    uint8_t sequence = 0;
+    uint32_t dropped = 0;
+
+    uint_fast64_t lastIteration = 0;
+    uint_fast64_t nextReport = 0;
+    uint32_t iterations = 0;
+    uint32_t longest = 0;
+
+    uint8_t line[telemetryWire::RECORD_BYTES];
+    uint8_t lineIndex = telemetryWire::RECORD_BYTES;    /**< next byte of line to write, the size when done */
+
+#ifndef HWLIB_HOST
+    // the UART of the programming port, set up by hwlib::cout
+    static volatile uint32_t & reg(uint32_t address) {
+        return *reinterpret_cast<volatile uint32_t *>(address);
+    }
+    static constexpr uint32_t UART_SR = 0x400E0814;
+    static constexpr uint32_t UART_THR = 0x400E081C;
+
+    static bool ready() {
+        return reg(UART_SR) & (1u << 1);     // TXRDY
+    }
+
+    static void put(uint8_t byte) {
+        reg(UART_THR) = byte;
+    }
+#else
+    static bool ready() {
+        return hwlib::host::uart_ready();
+    }
+
+    static void put(uint8_t byte) {
+        hwlib::host::uart_put(byte);
+    }
+#endif
+
+public:
+    /**
+     * \brief Standard constructor, writes a text line that marks the start of the stream,
+     * which also makes hwlib set up the UART
+     */
+    telemetryStream() {
+        hwlib::cout << "telemetry-begin " << (uint32_t) telemetryWire::RECORD_BYTES << hwlib::endl;
+    }
+
+    /**
+     * \brief queue a record, timestamped now
+     */
+    void record(telemetryType type, int16_t a, int16_t b = 0, int16_t c = 0) {
+        uint8_t s = sequence++;
+        if (count == SIZE) {
+            dropped++;
+            return;
+        }
+        records[(first + count) % SIZE] = telemetryRecord{ (uint32_t) hwlib::now_us(), a, b, c, type, s };
+        count++;
+    }
+
+    /**
+     * \brief call at the start of every loop iteration, records LOOP every REPORT_US
+     * returns true when it did, the other periodic records can go along with it
+     */
+    bool iteration() {
+        uint_fast64_t now = hwlib::now_us();
+        if (iterations) {
+            uint32_t took = now - lastIteration;
+            longest = took > longest ? took : longest;
+        } else {
+            nextReport = now + REPORT_US;
+        }
+        lastIteration = now;
+        iterations++;
+        if (now < nextReport) {
+            return false;
+        }
+        record(telemetryType::LOOP, iterations > INT16_MAX ? INT16_MAX : iterations,
+               longest > INT16_MAX ? INT16_MAX : longest);
+        iterations = 1;
+        longest = 0;
+        nextReport = now + REPORT_US;
+        return true;
+    }
+
+    /**
+     * \brief write what the UART takes without waiting
+     */
+    void drain() {
+        while (ready()) {
+            if (lineIndex == telemetryWire::RECORD_BYTES) {
+                if (!count) {
+                    return;
+                }
+                records[first].toBytes(line);
+                first = (first + 1) % SIZE;
+                count--;
+                lineIndex = 0;
+            }
+            put(line[lineIndex++]);
+        }
+    }
+
+    /**
+     * \brief drain(), for code that waits
+     */
+    void poll() override {
+        drain();
+    }
+
+    /**
+     * \brief records waiting in the buffer
+     */
+    size_t pending() const {
+        return count;
+    }
+
+    /**
+     * \brief records that did not fit in the buffer
+     */
+    uint32_t lost() const {
+        return dropped;
+    }
+};
+
+/**
+ * \class disabledTelemetry. same interface as telemetryStream, but does nothing at all
+ */
+template<size_t SIZE>
+class disabledTelemetry : public backgroundTask {
+public:
+    void record(telemetryType, int16_t, int16_t = 0, int16_t = 0) {}
+    bool iteration() { return false; }
+    void drain() {}
+    void poll() override {}
+    size_t pending() const { return 0; }
+    uint32_t lost() const { return 0; }
+};
+
+// The mains always declare a telemetry stream. It only records when RCCAR_TELEMETRY
+// is defined, for instance with `make TELEMETRY=1` in host/, otherwise every call
+// compiles to nothing.
+#ifdef RCCAR_TELEMETRY
+template<size_t SIZE>
+using telemetry = telemetryStream<SIZE>;
+#else
+template<size_t SIZE>
+using telemetry = disabledTelemetry<SIZE>;
+#endif
+
+#endif //RCCAR_TELEMETRY_HPP